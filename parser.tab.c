@@ -1,1844 +0,0 @@
-/* A Bison parser, made by GNU Bison 3.8.2.  */
-
-/* Bison implementation for Yacc-like parsers in C
-
-   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
-   Inc.
-
-   This program is free software: you can redistribute it and/or modify
-   it under the terms of the GNU General Public License as published by
-   the Free Software Foundation, either version 3 of the License, or
-   (at your option) any later version.
-
-   This program is distributed in the hope that it will be useful,
-   but WITHOUT ANY WARRANTY; without even the implied warranty of
-   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-   GNU General Public License for more details.
-
-   You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
-
-/* As a special exception, you may create a larger work that contains
-   part or all of the Bison parser skeleton and distribute that work
-   under terms of your choice, so long as that work isn't itself a
-   parser generator using the skeleton or a modified version thereof
-   as a parser skeleton.  Alternatively, if you modify or redistribute
-   the parser skeleton itself, you may (at your option) remove this
-   special exception, which will cause the skeleton and the resulting
-   Bison output files to be licensed under the GNU General Public
-   License without this special exception.
-
-   This special exception was added by the Free Software Foundation in
-   version 2.2 of Bison.  */
-
-/* C LALR(1) parser skeleton written by Richard Stallman, by
-   simplifying the original so-called "semantic" parser.  */
-
-/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
-   especially those whose name start with YY_ or yy_.  They are
-   private implementation details that can be changed or removed.  */
-
-/* All symbols defined below should begin with yy or YY, to avoid
-   infringing on user name space.  This should be done even for local
-   variables, as they might otherwise be expanded by user macros.
-   There are some unavoidable exceptions within include files to
-   define necessary library symbols; they are noted "INFRINGES ON
-   USER NAME SPACE" below.  */
-
-/* Identify Bison output, and Bison version.  */
-#define YYBISON 30802
-
-/* Bison version string.  */
-#define YYBISON_VERSION "3.8.2"
-
-/* Skeleton name.  */
-#define YYSKELETON_NAME "yacc.c"
-
-/* Pure parsers.  */
-#define YYPURE 0
-
-/* Push parsers.  */
-#define YYPUSH 0
-
-/* Pull parsers.  */
-#define YYPULL 1
-
-
-
-
-/* First part of user prologue.  */
-#line 1 "parser.y"
-
-/*
-  parser.y — Statements & correct if/else execution
-
-  Behaviors:
-  - Build statement trees during parsing (no execution during parse)
-  - After parsing the whole program, execute top-level statements (program -> stmts { execute_list($1); })
-  - Blocks inside if/else are kept as stmt-lists and only executed according to condition
-  - Printing of parse-trees goes to tree.txt at execution time
-  - Runtime outputs (Declared..., Assigned..., Print...) go to out.txt
-  - Errors go to outError.txt
-*/
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-int yylex(void);
-void yyerror(char *);
-void semantic_error(const char *msg, int line);
-
-extern int yylineno;
-extern FILE* yyin;
-extern FILE* yyout;
-FILE* yytree = NULL;
-FILE* yyError = NULL;
-
-/* symbol table: variables are represented by integer IDs provided by scanner */
-int sym[256];
-int declared[256]; /* track declared variables */
-
-int runtime_error = 0;
-
-/* Node kinds */
-enum {
-    N_UNKNOWN = 0,
-    N_INT,
-    N_VAR,
-    N_OP,       /* arithmetic or comparison operator node */
-    N_DECL,     /* declaration (dec) */
-    N_ASSIGN,   /* assign */
-    N_PRINT,    /* print */
-    N_IF,       /* if */
-    N_BRANCHES, /* helper node with then/else as children */
-    N_STMTLIST  /* linked list tree of statements: left = previous list, right = stmt */
-};
-
-/* ---- Node definition ---- */
-typedef struct Node {
-    char *label;          /* human-readable label (operator or node name) */
-    struct Node *left;
-    struct Node *right;
-    int kind;
-    int int_value;        /* for integer literal */
-    int var_id;           /* for variable nodes */
-    int line;
-} Node;
-
-/* helpers to create nodes */
-Node* new_node_kind(const char *label, int kind, Node *left, Node *right) {
-    Node *n = (Node*)malloc(sizeof(Node));
-    if (!n) { perror("malloc"); exit(1); }
-    n->label = strdup(label ? label : "");
-    n->left = left;
-    n->right = right;
-    n->kind = kind;
-    n->int_value = 0;
-    n->var_id = -1;
-    n->line = yylineno;
-    return n;
-}
-
-Node* new_int_node(int v) {
-    Node *n = new_node_kind(NULL, N_INT, NULL, NULL);
-    {
-        char buf[64];
-        sprintf(buf, "INTEGER(%d)", v);
-        free(n->label);
-        n->label = strdup(buf);
-    }
-    n->int_value = v;
-    return n;
-}
-
-Node* new_var_node(int id) {
-    Node *n = new_node_kind(NULL, N_VAR, NULL, NULL);
-    {
-        char buf[64];
-        sprintf(buf, "VAR(id=%d)", id);
-        free(n->label);
-        n->label = strdup(buf);
-    }
-    n->var_id = id;
-    return n;
-}
-
-Node* new_op_node(const char *op, Node *l, Node *r) {
-    Node *n = new_node_kind(op, N_OP, l, r);
-    return n;
-}
-
-Node* new_decl_node(Node *varNode, Node *exprNode) {
-    return new_node_kind("dec", N_DECL, varNode, exprNode);
-}
-
-Node* new_assign_node(Node *varNode, Node *exprNode) {
-    return new_node_kind("assign", N_ASSIGN, varNode, exprNode);
-}
-
-Node* new_print_node(Node *exprNode) {
-    return new_node_kind("print", N_PRINT, exprNode, NULL);
-}
-
-Node* new_if_node(Node *cond, Node *thenList, Node *elseList) {
-    Node *branches = new_node_kind("branches", N_BRANCHES, thenList, elseList);
-    return new_node_kind("if", N_IF, cond, branches);
-}
-
-Node* new_stmtlist_node(Node *prevList, Node *stmt) {
-    return new_node_kind("stmtlist", N_STMTLIST, prevList, stmt);
-}
-
-/* free tree */
-void free_tree(Node *n) {
-    if (!n) return;
-    free_tree(n->left);
-    free_tree(n->right);
-    if (n->label) free(n->label);
-    free(n);
-}
-
-/* ---- printing rotated vertical tree to yytree (like doctor style) ---- */
-void printTreeVertical(Node *root, int space) {
-    if (root == NULL) return;
-
-    if(root->kind == N_STMTLIST)
-    {
-        printTreeVertical(root->left, space);
-        printTreeVertical(root->right, space);
-        return;
-    }
-
-    int spacing_per_level = 5;
-    space += spacing_per_level;
-
-    printTreeVertical(root->right, space);
-
-    fprintf(yytree, "\n");
-    for (int i = spacing_per_level; i < space; i++)
-        fprintf(yytree, " ");
-    fprintf(yytree, "%s\n", root->label);
-
-    printTreeVertical(root->left, space);
-}
-
-/* print top-level separation */
-void print_tree_header(Node *n) {
-    if (!n) return;
-
-    if(n->kind == N_STMTLIST)
-    {
-        print_tree_header(n->left);
-        print_tree_header(n->right);
-        return;
-    }
-
-    printTreeVertical(n, 0);
-    fprintf(yytree, "\n--------------------------------------------------\n\n");
-}
-
-/* ---- evaluation of expressions at execution time ---- */
-int eval_expr(Node *n) {
-    if (!n) return 0;
-    switch (n->kind) {
-        case N_INT:
-            return n->int_value;
-        case N_VAR:
-            if(!declared[n->var_id]) {
-                semantic_error("Use of undeclared variable", n->line);
-                runtime_error = 1;
-                return 0;
-            }
-            return sym[n->var_id];
-        case N_OP: {
-            int L = eval_expr(n->left);
-            int R = eval_expr(n->right);
-            /* arithmetic */
-            if (strcmp(n->label, "+") == 0) return L + R;
-            if (strcmp(n->label, "-") == 0) return L - R;
-            if (strcmp(n->label, "*") == 0) return L * R;
-            if (strcmp(n->label, "/") == 0) {
-                if (R == 0) { yyerror("Division by zero"); runtime_error = 1; return 0; }
-                return L / R;
-            }
-            /* comparisons -> return 0/1 */
-            if (strcmp(n->label, "==") == 0) return (L == R);
-            if (strcmp(n->label, "!=") == 0) return (L != R);
-            if (strcmp(n->label, "<=") == 0) return (L <= R);
-            if (strcmp(n->label, ">=") == 0) return (L >= R);
-            if (strcmp(n->label, "<") == 0) return (L < R);
-            if (strcmp(n->label, ">") == 0) return (L > R);
-            /* unknown op */
-            yyerror("Unknown operator in eval_expr");
-            return 0;
-        }
-        default:
-            yyerror("eval_expr: expected expression node");
-            return 0;
-    }
-}
-
-/* Forward declarations */
-void execute_stmt(Node *stmt);
-void execute_list(Node *list);
-
-/* execute a single statement node */
-void execute_stmt(Node *stmt) {
-    if (!stmt) return;
-    
-
-    /* Print the statement tree to tree.txt before executing (so tree.txt reflects executed statements) */
-    print_tree_header(stmt);
-
-    switch (stmt->kind) {
-        case N_DECL: {
-            /* left is var node, right is expression node */
-            runtime_error = 0;
-            int val = eval_expr(stmt->right);
-            if (runtime_error) return;
-            Node *varNode = stmt->left;
-            Node *exprNode = stmt->right;
-            if (varNode->kind == N_VAR) {
-                int id = varNode->var_id;
-                declared[id] = 1; /* mark as declared */
-                sym[id] = val;
-                fprintf(yyout, "STORE var[%d] = %d\n", id, val);
-            } else {
-                yyerror("Declaration left side is not a variable");
-            }
-            break;
-        }
-        case N_ASSIGN: {
-            runtime_error = 0;
-            int v = eval_expr(stmt->right);
-            if (runtime_error) return;
-            Node *varNode = stmt->left;
-            Node *exprNode = stmt->right;
-            int val = eval_expr(exprNode);
-            if (varNode->kind == N_VAR) {
-                int id = varNode->var_id;
-                if (!declared[id]) {
-                    semantic_error("Assignment to undeclared variable", varNode->line);
-                    return;
-                }
-                sym[id] = val;
-                fprintf(yyout, "MOV var[%d] = %d\n", id, val);
-            } else {
-                yyerror("Assignment left side is not a variable");
-            }
-            break;
-        }
-        case N_PRINT: {
-            runtime_error = 0;
-            int v = eval_expr(stmt->left);
-            if (runtime_error) return;
-            Node *exprNode = stmt->left;
-            int val = eval_expr(exprNode);
-            fprintf(yyout, "Print: %d\n", val);
-            break;
-        }
-        case N_IF: {
-            runtime_error = 0;
-            int v = eval_expr(stmt->left);
-            if (runtime_error) return;
-            Node *cond = stmt->left;
-            Node *branches = stmt->right; /* branches node: left=thenList, right=elseList */
-            int cond_val = eval_expr(cond);
-            if (branches && branches->kind == N_BRANCHES) {
-                Node *thenList = branches->left;
-                Node *elseList = branches->right;
-                if (cond_val) {
-                    execute_list(thenList);
-                } else {
-                    execute_list(elseList);
-                }
-            } else {
-                yyerror("If branches malformed");
-            }
-            break;
-        }
-        case N_STMTLIST: {
-            /* If accidentally a stmtlist passed directly, execute it */
-            execute_list(stmt);
-            break;
-        }
-        default:
-            yyerror("Unknown statement kind in execute_stmt");
-            break;
-    }
-}
-
-/* execute a list-of-statements node (stmtlist) */
-void execute_list(Node *list) {
-    if (!list) return;
-    if (list->kind == N_STMTLIST) {
-        /* left may be previous list (or NULL), right is a statement */
-        execute_list(list->left);
-        execute_stmt(list->right);
-    } else {
-        /* single statement */
-        execute_stmt(list);
-    }
-}
-
-void semantic_error(const char *msg, int line)
-{
-    fprintf(yyError, "Error: %s at line %d\n", msg, line);
-}
-
-
-#line 392 "parser.tab.c"
-
-# ifndef YY_CAST
-#  ifdef __cplusplus
-#   define YY_CAST(Type, Val) static_cast<Type> (Val)
-#   define YY_REINTERPRET_CAST(Type, Val) reinterpret_cast<Type> (Val)
-#  else
-#   define YY_CAST(Type, Val) ((Type) (Val))
-#   define YY_REINTERPRET_CAST(Type, Val) ((Type) (Val))
-#  endif
-# endif
-# ifndef YY_NULLPTR
-#  if defined __cplusplus
-#   if 201103L <= __cplusplus
-#    define YY_NULLPTR nullptr
-#   else
-#    define YY_NULLPTR 0
-#   endif
-#  else
-#   define YY_NULLPTR ((void*)0)
-#  endif
-# endif
-
-#include "parser.tab.h"
-/* Symbol kind.  */
-enum yysymbol_kind_t
-{
-  YYSYMBOL_YYEMPTY = -2,
-  YYSYMBOL_YYEOF = 0,                      /* "end of file"  */
-  YYSYMBOL_YYerror = 1,                    /* error  */
-  YYSYMBOL_YYUNDEF = 2,                    /* "invalid token"  */
-  YYSYMBOL_INTEGER = 3,                    /* INTEGER  */
-  YYSYMBOL_VARIABLE = 4,                   /* VARIABLE  */
-  YYSYMBOL_PRINT = 5,                      /* PRINT  */
-  YYSYMBOL_IF = 6,                         /* IF  */
-  YYSYMBOL_ELSE = 7,                       /* ELSE  */
-  YYSYMBOL_INT = 8,                        /* INT  */
-  YYSYMBOL_END = 9,                        /* END  */
-  YYSYMBOL_OP = 10,                        /* OP  */
-  YYSYMBOL_LOWER_ELSE = 11,                /* LOWER_ELSE  */
-  YYSYMBOL_12_ = 12,                       /* '='  */
-  YYSYMBOL_13_ = 13,                       /* '+'  */
-  YYSYMBOL_14_ = 14,                       /* '-'  */
-  YYSYMBOL_15_ = 15,                       /* '*'  */
-  YYSYMBOL_16_ = 16,                       /* '/'  */
-  YYSYMBOL_17_ = 17,                       /* ';'  */
-  YYSYMBOL_18_ = 18,                       /* '('  */
-  YYSYMBOL_19_ = 19,                       /* ')'  */
-  YYSYMBOL_20_ = 20,                       /* ':'  */
-  YYSYMBOL_YYACCEPT = 21,                  /* $accept  */
-  YYSYMBOL_program = 22,                   /* program  */
-  YYSYMBOL_stmts = 23,                     /* stmts  */
-  YYSYMBOL_stmt = 24,                      /* stmt  */
-  YYSYMBOL_declaration = 25,               /* declaration  */
-  YYSYMBOL_assignment = 26,                /* assignment  */
-  YYSYMBOL_printStatement = 27,            /* printStatement  */
-  YYSYMBOL_IfStatement = 28,               /* IfStatement  */
-  YYSYMBOL_block = 29,                     /* block  */
-  YYSYMBOL_condition = 30,                 /* condition  */
-  YYSYMBOL_expr = 31                       /* expr  */
-};
-typedef enum yysymbol_kind_t yysymbol_kind_t;
-
-
-
-
-#ifdef short
-# undef short
-#endif
-
-/* On compilers that do not define __PTRDIFF_MAX__ etc., make sure
-   <limits.h> and (if available) <stdint.h> are included
-   so that the code can choose integer types of a good width.  */
-
-#ifndef __PTRDIFF_MAX__
-# include <limits.h> /* INFRINGES ON USER NAME SPACE */
-# if defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
-#  include <stdint.h> /* INFRINGES ON USER NAME SPACE */
-#  define YY_STDINT_H
-# endif
-#endif
-
-/* Narrow types that promote to a signed type and that can represent a
-   signed or unsigned integer of at least N bits.  In tables they can
-   save space and decrease cache pressure.  Promoting to a signed type
-   helps avoid bugs in integer arithmetic.  */
-
-#ifdef __INT_LEAST8_MAX__
-typedef __INT_LEAST8_TYPE__ yytype_int8;
-#elif defined YY_STDINT_H
-typedef int_least8_t yytype_int8;
-#else
-typedef signed char yytype_int8;
-#endif
-
-#ifdef __INT_LEAST16_MAX__
-typedef __INT_LEAST16_TYPE__ yytype_int16;
-#elif defined YY_STDINT_H
-typedef int_least16_t yytype_int16;
-#else
-typedef short yytype_int16;
-#endif
-
-/* Work around bug in HP-UX 11.23, which defines these macros
-   incorrectly for preprocessor constants.  This workaround can likely
-   be removed in 2023, as HPE has promised support for HP-UX 11.23
-   (aka HP-UX 11i v2) only through the end of 2022; see Table 2 of
-   <https://h20195.www2.hpe.com/V2/getpdf.aspx/4AA4-7673ENW.pdf>.  */
-#ifdef __hpux
-# undef UINT_LEAST8_MAX
-# undef UINT_LEAST16_MAX
-# define UINT_LEAST8_MAX 255
-# define UINT_LEAST16_MAX 65535
-#endif
-
-#if defined __UINT_LEAST8_MAX__ && __UINT_LEAST8_MAX__ <= __INT_MAX__
-typedef __UINT_LEAST8_TYPE__ yytype_uint8;
-#elif (!defined __UINT_LEAST8_MAX__ && defined YY_STDINT_H \
-       && UINT_LEAST8_MAX <= INT_MAX)
-typedef uint_least8_t yytype_uint8;
-#elif !defined __UINT_LEAST8_MAX__ && UCHAR_MAX <= INT_MAX
-typedef unsigned char yytype_uint8;
-#else
-typedef short yytype_uint8;
-#endif
-
-#if defined __UINT_LEAST16_MAX__ && __UINT_LEAST16_MAX__ <= __INT_MAX__
-typedef __UINT_LEAST16_TYPE__ yytype_uint16;
-#elif (!defined __UINT_LEAST16_MAX__ && defined YY_STDINT_H \
-       && UINT_LEAST16_MAX <= INT_MAX)
-typedef uint_least16_t yytype_uint16;
-#elif !defined __UINT_LEAST16_MAX__ && USHRT_MAX <= INT_MAX
-typedef unsigned short yytype_uint16;
-#else
-typedef int yytype_uint16;
-#endif
-
-#ifndef YYPTRDIFF_T
-# if defined __PTRDIFF_TYPE__ && defined __PTRDIFF_MAX__
-#  define YYPTRDIFF_T __PTRDIFF_TYPE__
-#  define YYPTRDIFF_MAXIMUM __PTRDIFF_MAX__
-# elif defined PTRDIFF_MAX
-#  ifndef ptrdiff_t
-#   include <stddef.h> /* INFRINGES ON USER NAME SPACE */
-#  endif
-#  define YYPTRDIFF_T ptrdiff_t
-#  define YYPTRDIFF_MAXIMUM PTRDIFF_MAX
-# else
-#  define YYPTRDIFF_T long
-#  define YYPTRDIFF_MAXIMUM LONG_MAX
-# endif
-#endif
-
-#ifndef YYSIZE_T
-# ifdef __SIZE_TYPE__
-#  define YYSIZE_T __SIZE_TYPE__
-# elif defined size_t
-#  define YYSIZE_T size_t
-# elif defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
-#  include <stddef.h> /* INFRINGES ON USER NAME SPACE */
-#  define YYSIZE_T size_t
-# else
-#  define YYSIZE_T unsigned
-# endif
-#endif
-
-#define YYSIZE_MAXIMUM                                  \
-  YY_CAST (YYPTRDIFF_T,                                 \
-           (YYPTRDIFF_MAXIMUM < YY_CAST (YYSIZE_T, -1)  \
-            ? YYPTRDIFF_MAXIMUM                         \
-            : YY_CAST (YYSIZE_T, -1)))
-
-#define YYSIZEOF(X) YY_CAST (YYPTRDIFF_T, sizeof (X))
-
-
-/* Stored state numbers (used for stacks). */
-typedef yytype_int8 yy_state_t;
-
-/* State numbers in computations.  */
-typedef int yy_state_fast_t;
-
-#ifndef YY_
-# if defined YYENABLE_NLS && YYENABLE_NLS
-#  if ENABLE_NLS
-#   include <libintl.h> /* INFRINGES ON USER NAME SPACE */
-#   define YY_(Msgid) dgettext ("bison-runtime", Msgid)
-#  endif
-# endif
-# ifndef YY_
-#  define YY_(Msgid) Msgid
-# endif
-#endif
-
-
-#ifndef YY_ATTRIBUTE_PURE
-# if defined __GNUC__ && 2 < __GNUC__ + (96 <= __GNUC_MINOR__)
-#  define YY_ATTRIBUTE_PURE __attribute__ ((__pure__))
-# else
-#  define YY_ATTRIBUTE_PURE
-# endif
-#endif
-
-#ifndef YY_ATTRIBUTE_UNUSED
-# if defined __GNUC__ && 2 < __GNUC__ + (7 <= __GNUC_MINOR__)
-#  define YY_ATTRIBUTE_UNUSED __attribute__ ((__unused__))
-# else
-#  define YY_ATTRIBUTE_UNUSED
-# endif
-#endif
-
-/* Suppress unused-variable warnings by "using" E.  */
-#if ! defined lint || defined __GNUC__
-# define YY_USE(E) ((void) (E))
-#else
-# define YY_USE(E) /* empty */
-#endif
-
-/* Suppress an incorrect diagnostic about yylval being uninitialized.  */
-#if defined __GNUC__ && ! defined __ICC && 406 <= __GNUC__ * 100 + __GNUC_MINOR__
-# if __GNUC__ * 100 + __GNUC_MINOR__ < 407
-#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
-    _Pragma ("GCC diagnostic push")                                     \
-    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")
-# else
-#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
-    _Pragma ("GCC diagnostic push")                                     \
-    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")              \
-    _Pragma ("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
-# endif
-# define YY_IGNORE_MAYBE_UNINITIALIZED_END      \
-    _Pragma ("GCC diagnostic pop")
-#else
-# define YY_INITIAL_VALUE(Value) Value
-#endif
-#ifndef YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-# define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-# define YY_IGNORE_MAYBE_UNINITIALIZED_END
-#endif
-#ifndef YY_INITIAL_VALUE
-# define YY_INITIAL_VALUE(Value) /* Nothing. */
-#endif
-
-#if defined __cplusplus && defined __GNUC__ && ! defined __ICC && 6 <= __GNUC__
-# define YY_IGNORE_USELESS_CAST_BEGIN                          \
-    _Pragma ("GCC diagnostic push")                            \
-    _Pragma ("GCC diagnostic ignored \"-Wuseless-cast\"")
-# define YY_IGNORE_USELESS_CAST_END            \
-    _Pragma ("GCC diagnostic pop")
-#endif
-#ifndef YY_IGNORE_USELESS_CAST_BEGIN
-# define YY_IGNORE_USELESS_CAST_BEGIN
-# define YY_IGNORE_USELESS_CAST_END
-#endif
-
-
-#define YY_ASSERT(E) ((void) (0 && (E)))
-
-#if !defined yyoverflow
-
-/* The parser invokes alloca or malloc; define the necessary symbols.  */
-
-# ifdef YYSTACK_USE_ALLOCA
-#  if YYSTACK_USE_ALLOCA
-#   ifdef __GNUC__
-#    define YYSTACK_ALLOC __builtin_alloca
-#   elif defined __BUILTIN_VA_ARG_INCR
-#    include <alloca.h> /* INFRINGES ON USER NAME SPACE */
-#   elif defined _AIX
-#    define YYSTACK_ALLOC __alloca
-#   elif defined _MSC_VER
-#    include <malloc.h> /* INFRINGES ON USER NAME SPACE */
-#    define alloca _alloca
-#   else
-#    define YYSTACK_ALLOC alloca
-#    if ! defined _ALLOCA_H && ! defined EXIT_SUCCESS
-#     include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
-      /* Use EXIT_SUCCESS as a witness for stdlib.h.  */
-#     ifndef EXIT_SUCCESS
-#      define EXIT_SUCCESS 0
-#     endif
-#    endif
-#   endif
-#  endif
-# endif
-
-# ifdef YYSTACK_ALLOC
-   /* Pacify GCC's 'empty if-body' warning.  */
-#  define YYSTACK_FREE(Ptr) do { /* empty */; } while (0)
-#  ifndef YYSTACK_ALLOC_MAXIMUM
-    /* The OS might guarantee only one guard page at the bottom of the stack,
-       and a page size can be as small as 4096 bytes.  So we cannot safely
-       invoke alloca (N) if N exceeds 4096.  Use a slightly smaller number
-       to allow for a few compiler-allocated temporary stack slots.  */
-#   define YYSTACK_ALLOC_MAXIMUM 4032 /* reasonable circa 2006 */
-#  endif
-# else
-#  define YYSTACK_ALLOC YYMALLOC
-#  define YYSTACK_FREE YYFREE
-#  ifndef YYSTACK_ALLOC_MAXIMUM
-#   define YYSTACK_ALLOC_MAXIMUM YYSIZE_MAXIMUM
-#  endif
-#  if (defined __cplusplus && ! defined EXIT_SUCCESS \
-       && ! ((defined YYMALLOC || defined malloc) \
-             && (defined YYFREE || defined free)))
-#   include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
-#   ifndef EXIT_SUCCESS
-#    define EXIT_SUCCESS 0
-#   endif
-#  endif
-#  ifndef YYMALLOC
-#   define YYMALLOC malloc
-#   if ! defined malloc && ! defined EXIT_SUCCESS
-void *malloc (YYSIZE_T); /* INFRINGES ON USER NAME SPACE */
-#   endif
-#  endif
-#  ifndef YYFREE
-#   define YYFREE free
-#   if ! defined free && ! defined EXIT_SUCCESS
-void free (void *); /* INFRINGES ON USER NAME SPACE */
-#   endif
-#  endif
-# endif
-#endif /* !defined yyoverflow */
-
-#if (! defined yyoverflow \
-     && (! defined __cplusplus \
-         || (defined YYSTYPE_IS_TRIVIAL && YYSTYPE_IS_TRIVIAL)))
-
-/* A type that is properly aligned for any stack member.  */
-union yyalloc
-{
-  yy_state_t yyss_alloc;
-  YYSTYPE yyvs_alloc;
-};
-
-/* The size of the maximum gap between one aligned stack and the next.  */
-# define YYSTACK_GAP_MAXIMUM (YYSIZEOF (union yyalloc) - 1)
-
-/* The size of an array large to enough to hold all stacks, each with
-   N elements.  */
-# define YYSTACK_BYTES(N) \
-     ((N) * (YYSIZEOF (yy_state_t) + YYSIZEOF (YYSTYPE)) \
-      + YYSTACK_GAP_MAXIMUM)
-
-# define YYCOPY_NEEDED 1
-
-/* Relocate STACK from its old location to the new one.  The
-   local variables YYSIZE and YYSTACKSIZE give the old and new number of
-   elements in the stack, and YYPTR gives the new location of the
-   stack.  Advance YYPTR to a properly aligned location for the next
-   stack.  */
-# define YYSTACK_RELOCATE(Stack_alloc, Stack)                           \
-    do                                                                  \
-      {                                                                 \
-        YYPTRDIFF_T yynewbytes;                                         \
-        YYCOPY (&yyptr->Stack_alloc, Stack, yysize);                    \
-        Stack = &yyptr->Stack_alloc;                                    \
-        yynewbytes = yystacksize * YYSIZEOF (*Stack) + YYSTACK_GAP_MAXIMUM; \
-        yyptr += yynewbytes / YYSIZEOF (*yyptr);                        \
-      }                                                                 \
-    while (0)
-
-#endif
-
-#if defined YYCOPY_NEEDED && YYCOPY_NEEDED
-/* Copy COUNT objects from SRC to DST.  The source and destination do
-   not overlap.  */
-# ifndef YYCOPY
-#  if defined __GNUC__ && 1 < __GNUC__
-#   define YYCOPY(Dst, Src, Count) \
-      __builtin_memcpy (Dst, Src, YY_CAST (YYSIZE_T, (Count)) * sizeof (*(Src)))
-#  else
-#   define YYCOPY(Dst, Src, Count)              \
-      do                                        \
-        {                                       \
-          YYPTRDIFF_T yyi;                      \
-          for (yyi = 0; yyi < (Count); yyi++)   \
-            (Dst)[yyi] = (Src)[yyi];            \
-        }                                       \
-      while (0)
-#  endif
-# endif
-#endif /* !YYCOPY_NEEDED */
-
-/* YYFINAL -- State number of the termination state.  */
-#define YYFINAL  3
-/* YYLAST -- Last index in YYTABLE.  */
-#define YYLAST   69
-
-/* YYNTOKENS -- Number of terminals.  */
-#define YYNTOKENS  21
-/* YYNNTS -- Number of nonterminals.  */
-#define YYNNTS  11
-/* YYNRULES -- Number of rules.  */
-#define YYNRULES  23
-/* YYNSTATES -- Number of states.  */
-#define YYNSTATES  53
-
-/* YYMAXUTOK -- Last valid token kind.  */
-#define YYMAXUTOK   266
-
-
-/* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
-   as returned by yylex, with out-of-bounds checking.  */
-#define YYTRANSLATE(YYX)                                \
-  (0 <= (YYX) && (YYX) <= YYMAXUTOK                     \
-   ? YY_CAST (yysymbol_kind_t, yytranslate[YYX])        \
-   : YYSYMBOL_YYUNDEF)
-
-/* YYTRANSLATE[TOKEN-NUM] -- Symbol number corresponding to TOKEN-NUM
-   as returned by yylex.  */
-static const yytype_int8 yytranslate[] =
-{
-       0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-      18,    19,    15,    13,     2,    14,     2,    16,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,    20,    17,
-       2,    12,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     1,     2,     3,     4,
-       5,     6,     7,     8,     9,    10,    11
-};
-
-#if YYDEBUG
-/* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
-static const yytype_int16 yyrline[] =
-{
-       0,   352,   352,   361,   362,   375,   376,   377,   378,   379,
-     387,   398,   408,   417,   422,   431,   439,   450,   454,   458,
-     462,   466,   470,   474
-};
-#endif
-
-/** Accessing symbol of state STATE.  */
-#define YY_ACCESSING_SYMBOL(State) YY_CAST (yysymbol_kind_t, yystos[State])
-
-#if YYDEBUG || 0
-/* The user-facing name of the symbol whose (internal) number is
-   YYSYMBOL.  No bounds checking.  */
-static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
-
-/* YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
-   First, the terminals, then, starting at YYNTOKENS, nonterminals.  */
-static const char *const yytname[] =
-{
-  "\"end of file\"", "error", "\"invalid token\"", "INTEGER", "VARIABLE",
-  "PRINT", "IF", "ELSE", "INT", "END", "OP", "LOWER_ELSE", "'='", "'+'",
-  "'-'", "'*'", "'/'", "';'", "'('", "')'", "':'", "$accept", "program",
-  "stmts", "stmt", "declaration", "assignment", "printStatement",
-  "IfStatement", "block", "condition", "expr", YY_NULLPTR
-};
-
-static const char *
-yysymbol_name (yysymbol_kind_t yysymbol)
-{
-  return yytname[yysymbol];
-}
-#endif
-
-#define YYPACT_NINF (-10)
-
-#define yypact_value_is_default(Yyn) \
-  ((Yyn) == YYPACT_NINF)
-
-#define YYTABLE_NINF (-1)
-
-#define yytable_value_is_error(Yyn) \
-  0
-
-/* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
-   STATE-NUM.  */
-static const yytype_int8 yypact[] =
-{
-     -10,     1,    15,   -10,   -10,    -7,    -6,    10,    25,    -1,
-     -10,   -10,   -10,   -10,   -10,    32,    -1,    -1,    -1,    20,
-     -10,    11,    -1,    -1,    -1,    -1,   -10,    37,    21,    45,
-      28,    -1,   -10,    -5,    -5,   -10,   -10,   -10,    22,    46,
-      -1,    42,   -10,   -10,    47,   -10,    15,    -3,    48,   -10,
-     -10,    56,   -10
-};
-
-/* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
-   Performed when YYTABLE does not specify something else to do.  Zero
-   means the default is an error.  */
-static const yytype_int8 yydefact[] =
-{
-       3,     0,     2,     1,    17,    18,     0,     0,     0,     0,
-       4,     5,     6,     7,     8,     0,     0,     0,     0,     0,
-      18,     0,     0,     0,     0,     0,     9,     0,     0,     0,
-       0,     0,    23,    19,    20,    21,    22,    11,     0,     0,
-       0,     0,    12,     3,    16,    10,    15,     0,     0,    14,
-       3,     0,    13
-};
-
-/* YYPGOTO[NTERM-NUM].  */
-static const yytype_int8 yypgoto[] =
-{
-     -10,   -10,    67,   -10,   -10,   -10,   -10,   -10,    19,   -10,
-      -9
-};
-
-/* YYDEFGOTO[NTERM-NUM].  */
-static const yytype_int8 yydefgoto[] =
-{
-       0,     1,    46,    10,    11,    12,    13,    14,    47,    29,
-      15
-};
-
-/* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
-   positive, shift that token.  If negative, reduce the rule whose
-   number is the opposite.  If YYTABLE_NINF, syntax error.  */
-static const yytype_int8 yytable[] =
-{
-      21,     3,     4,    20,    48,    16,    49,    27,    28,    30,
-      24,    25,    17,    33,    34,    35,    36,     9,     4,     5,
-       6,     7,    41,     8,    22,    23,    24,    25,    18,    19,
-      32,    44,    31,     9,    22,    23,    24,    25,    40,    42,
-      38,    22,    23,    24,    25,    22,    23,    24,    25,    26,
-      22,    23,    24,    25,    37,    22,    23,    24,    25,    45,
-      22,    23,    24,    25,    39,    52,    43,     2,    50,    51
-};
-
-static const yytype_int8 yycheck[] =
-{
-       9,     0,     3,     4,     7,    12,     9,    16,    17,    18,
-      15,    16,    18,    22,    23,    24,    25,    18,     3,     4,
-       5,     6,    31,     8,    13,    14,    15,    16,    18,     4,
-      19,    40,    12,    18,    13,    14,    15,    16,    10,    17,
-      19,    13,    14,    15,    16,    13,    14,    15,    16,    17,
-      13,    14,    15,    16,    17,    13,    14,    15,    16,    17,
-      13,    14,    15,    16,    19,     9,    20,     0,    20,    50
-};
-
-/* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
-   state STATE-NUM.  */
-static const yytype_int8 yystos[] =
-{
-       0,    22,    23,     0,     3,     4,     5,     6,     8,    18,
-      24,    25,    26,    27,    28,    31,    12,    18,    18,     4,
-       4,    31,    13,    14,    15,    16,    17,    31,    31,    30,
-      31,    12,    19,    31,    31,    31,    31,    17,    19,    19,
-      10,    31,    17,    20,    31,    17,    23,    29,     7,     9,
-      20,    29,     9
-};
-
-/* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
-static const yytype_int8 yyr1[] =
-{
-       0,    21,    22,    23,    23,    24,    24,    24,    24,    24,
-      25,    26,    27,    28,    28,    29,    30,    31,    31,    31,
-      31,    31,    31,    31
-};
-
-/* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
-static const yytype_int8 yyr2[] =
-{
-       0,     2,     1,     0,     2,     1,     1,     1,     1,     2,
-       5,     4,     5,    10,     7,     1,     3,     1,     1,     3,
-       3,     3,     3,     3
-};
-
-
-enum { YYENOMEM = -2 };
-
-#define yyerrok         (yyerrstatus = 0)
-#define yyclearin       (yychar = YYEMPTY)
-
-#define YYACCEPT        goto yyacceptlab
-#define YYABORT         goto yyabortlab
-#define YYERROR         goto yyerrorlab
-#define YYNOMEM         goto yyexhaustedlab
-
-
-#define YYRECOVERING()  (!!yyerrstatus)
-
-#define YYBACKUP(Token, Value)                                    \
-  do                                                              \
-    if (yychar == YYEMPTY)                                        \
-      {                                                           \
-        yychar = (Token);                                         \
-        yylval = (Value);                                         \
-        YYPOPSTACK (yylen);                                       \
-        yystate = *yyssp;                                         \
-        goto yybackup;                                            \
-      }                                                           \
-    else                                                          \
-      {                                                           \
-        yyerror (YY_("syntax error: cannot back up")); \
-        YYERROR;                                                  \
-      }                                                           \
-  while (0)
-
-/* Backward compatibility with an undocumented macro.
-   Use YYerror or YYUNDEF. */
-#define YYERRCODE YYUNDEF
-
-
-/* Enable debugging if requested.  */
-#if YYDEBUG
-
-# ifndef YYFPRINTF
-#  include <stdio.h> /* INFRINGES ON USER NAME SPACE */
-#  define YYFPRINTF fprintf
-# endif
-
-# define YYDPRINTF(Args)                        \
-do {                                            \
-  if (yydebug)                                  \
-    YYFPRINTF Args;                             \
-} while (0)
-
-
-
-
-# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)                    \
-do {                                                                      \
-  if (yydebug)                                                            \
-    {                                                                     \
-      YYFPRINTF (stderr, "%s ", Title);                                   \
-      yy_symbol_print (stderr,                                            \
-                  Kind, Value); \
-      YYFPRINTF (stderr, "\n");                                           \
-    }                                                                     \
-} while (0)
-
-
-/*-----------------------------------.
-| Print this symbol's value on YYO.  |
-`-----------------------------------*/
-
-static void
-yy_symbol_value_print (FILE *yyo,
-                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep)
-{
-  FILE *yyoutput = yyo;
-  YY_USE (yyoutput);
-  if (!yyvaluep)
-    return;
-  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-  YY_USE (yykind);
-  YY_IGNORE_MAYBE_UNINITIALIZED_END
-}
-
-
-/*---------------------------.
-| Print this symbol on YYO.  |
-`---------------------------*/
-
-static void
-yy_symbol_print (FILE *yyo,
-                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep)
-{
-  YYFPRINTF (yyo, "%s %s (",
-             yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
-
-  yy_symbol_value_print (yyo, yykind, yyvaluep);
-  YYFPRINTF (yyo, ")");
-}
-
-/*------------------------------------------------------------------.
-| yy_stack_print -- Print the state stack from its BOTTOM up to its |
-| TOP (included).                                                   |
-`------------------------------------------------------------------*/
-
-static void
-yy_stack_print (yy_state_t *yybottom, yy_state_t *yytop)
-{
-  YYFPRINTF (stderr, "Stack now");
-  for (; yybottom <= yytop; yybottom++)
-    {
-      int yybot = *yybottom;
-      YYFPRINTF (stderr, " %d", yybot);
-    }
-  YYFPRINTF (stderr, "\n");
-}
-
-# define YY_STACK_PRINT(Bottom, Top)                            \
-do {                                                            \
-  if (yydebug)                                                  \
-    yy_stack_print ((Bottom), (Top));                           \
-} while (0)
-
-
-/*------------------------------------------------.
-| Report that the YYRULE is going to be reduced.  |
-`------------------------------------------------*/
-
-static void
-yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
-                 int yyrule)
-{
-  int yylno = yyrline[yyrule];
-  int yynrhs = yyr2[yyrule];
-  int yyi;
-  YYFPRINTF (stderr, "Reducing stack by rule %d (line %d):\n",
-             yyrule - 1, yylno);
-  /* The symbols being reduced.  */
-  for (yyi = 0; yyi < yynrhs; yyi++)
-    {
-      YYFPRINTF (stderr, "   $%d = ", yyi + 1);
-      yy_symbol_print (stderr,
-                       YY_ACCESSING_SYMBOL (+yyssp[yyi + 1 - yynrhs]),
-                       &yyvsp[(yyi + 1) - (yynrhs)]);
-      YYFPRINTF (stderr, "\n");
-    }
-}
-
-# define YY_REDUCE_PRINT(Rule)          \
-do {                                    \
-  if (yydebug)                          \
-    yy_reduce_print (yyssp, yyvsp, Rule); \
-} while (0)
-
-/* Nonzero means print parse trace.  It is left uninitialized so that
-   multiple parsers can coexist.  */
-int yydebug;
-#else /* !YYDEBUG */
-# define YYDPRINTF(Args) ((void) 0)
-# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)
-# define YY_STACK_PRINT(Bottom, Top)
-# define YY_REDUCE_PRINT(Rule)
-#endif /* !YYDEBUG */
-
-
-/* YYINITDEPTH -- initial size of the parser's stacks.  */
-#ifndef YYINITDEPTH
-# define YYINITDEPTH 200
-#endif
-
-/* YYMAXDEPTH -- maximum size the stacks can grow to (effective only
-   if the built-in stack extension method is used).
-
-   Do not make this value too large; the results are undefined if
-   YYSTACK_ALLOC_MAXIMUM < YYSTACK_BYTES (YYMAXDEPTH)
-   evaluated with infinite-precision integer arithmetic.  */
-
-#ifndef YYMAXDEPTH
-# define YYMAXDEPTH 10000
-#endif
-
-
-
-
-
-
-/*-----------------------------------------------.
-| Release the memory associated to this symbol.  |
-`-----------------------------------------------*/
-
-static void
-yydestruct (const char *yymsg,
-            yysymbol_kind_t yykind, YYSTYPE *yyvaluep)
-{
-  YY_USE (yyvaluep);
-  if (!yymsg)
-    yymsg = "Deleting";
-  YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
-
-  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-  YY_USE (yykind);
-  YY_IGNORE_MAYBE_UNINITIALIZED_END
-}
-
-
-/* Lookahead token kind.  */
-int yychar;
-
-/* The semantic value of the lookahead symbol.  */
-YYSTYPE yylval;
-/* Number of syntax errors so far.  */
-int yynerrs;
-
-
-
-
-/*----------.
-| yyparse.  |
-`----------*/
-
-int
-yyparse (void)
-{
-    yy_state_fast_t yystate = 0;
-    /* Number of tokens to shift before error messages enabled.  */
-    int yyerrstatus = 0;
-
-    /* Refer to the stacks through separate pointers, to allow yyoverflow
-       to reallocate them elsewhere.  */
-
-    /* Their size.  */
-    YYPTRDIFF_T yystacksize = YYINITDEPTH;
-
-    /* The state stack: array, bottom, top.  */
-    yy_state_t yyssa[YYINITDEPTH];
-    yy_state_t *yyss = yyssa;
-    yy_state_t *yyssp = yyss;
-
-    /* The semantic value stack: array, bottom, top.  */
-    YYSTYPE yyvsa[YYINITDEPTH];
-    YYSTYPE *yyvs = yyvsa;
-    YYSTYPE *yyvsp = yyvs;
-
-  int yyn;
-  /* The return value of yyparse.  */
-  int yyresult;
-  /* Lookahead symbol kind.  */
-  yysymbol_kind_t yytoken = YYSYMBOL_YYEMPTY;
-  /* The variables used to return semantic value and location from the
-     action routines.  */
-  YYSTYPE yyval;
-
-
-
-#define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N))
-
-  /* The number of symbols on the RHS of the reduced rule.
-     Keep to zero when no symbol should be popped.  */
-  int yylen = 0;
-
-  YYDPRINTF ((stderr, "Starting parse\n"));
-
-  yychar = YYEMPTY; /* Cause a token to be read.  */
-
-  goto yysetstate;
-
-
-/*------------------------------------------------------------.
-| yynewstate -- push a new state, which is found in yystate.  |
-`------------------------------------------------------------*/
-yynewstate:
-  /* In all cases, when you get here, the value and location stacks
-     have just been pushed.  So pushing a state here evens the stacks.  */
-  yyssp++;
-
-
-/*--------------------------------------------------------------------.
-| yysetstate -- set current state (the top of the stack) to yystate.  |
-`--------------------------------------------------------------------*/
-yysetstate:
-  YYDPRINTF ((stderr, "Entering state %d\n", yystate));
-  YY_ASSERT (0 <= yystate && yystate < YYNSTATES);
-  YY_IGNORE_USELESS_CAST_BEGIN
-  *yyssp = YY_CAST (yy_state_t, yystate);
-  YY_IGNORE_USELESS_CAST_END
-  YY_STACK_PRINT (yyss, yyssp);
-
-  if (yyss + yystacksize - 1 <= yyssp)
-#if !defined yyoverflow && !defined YYSTACK_RELOCATE
-    YYNOMEM;
-#else
-    {
-      /* Get the current used size of the three stacks, in elements.  */
-      YYPTRDIFF_T yysize = yyssp - yyss + 1;
-
-# if defined yyoverflow
-      {
-        /* Give user a chance to reallocate the stack.  Use copies of
-           these so that the &'s don't force the real ones into
-           memory.  */
-        yy_state_t *yyss1 = yyss;
-        YYSTYPE *yyvs1 = yyvs;
-
-        /* Each stack pointer address is followed by the size of the
-           data in use in that stack, in bytes.  This used to be a
-           conditional around just the two extra args, but that might
-           be undefined if yyoverflow is a macro.  */
-        yyoverflow (YY_("memory exhausted"),
-                    &yyss1, yysize * YYSIZEOF (*yyssp),
-                    &yyvs1, yysize * YYSIZEOF (*yyvsp),
-                    &yystacksize);
-        yyss = yyss1;
-        yyvs = yyvs1;
-      }
-# else /* defined YYSTACK_RELOCATE */
-      /* Extend the stack our own way.  */
-      if (YYMAXDEPTH <= yystacksize)
-        YYNOMEM;
-      yystacksize *= 2;
-      if (YYMAXDEPTH < yystacksize)
-        yystacksize = YYMAXDEPTH;
-
-      {
-        yy_state_t *yyss1 = yyss;
-        union yyalloc *yyptr =
-          YY_CAST (union yyalloc *,
-                   YYSTACK_ALLOC (YY_CAST (YYSIZE_T, YYSTACK_BYTES (yystacksize))));
-        if (! yyptr)
-          YYNOMEM;
-        YYSTACK_RELOCATE (yyss_alloc, yyss);
-        YYSTACK_RELOCATE (yyvs_alloc, yyvs);
-#  undef YYSTACK_RELOCATE
-        if (yyss1 != yyssa)
-          YYSTACK_FREE (yyss1);
-      }
-# endif
-
-      yyssp = yyss + yysize - 1;
-      yyvsp = yyvs + yysize - 1;
-
-      YY_IGNORE_USELESS_CAST_BEGIN
-      YYDPRINTF ((stderr, "Stack size increased to %ld\n",
-                  YY_CAST (long, yystacksize)));
-      YY_IGNORE_USELESS_CAST_END
-
-      if (yyss + yystacksize - 1 <= yyssp)
-        YYABORT;
-    }
-#endif /* !defined yyoverflow && !defined YYSTACK_RELOCATE */
-
-
-  if (yystate == YYFINAL)
-    YYACCEPT;
-
-  goto yybackup;
-
-
-/*-----------.
-| yybackup.  |
-`-----------*/
-yybackup:
-  /* Do appropriate processing given the current state.  Read a
-     lookahead token if we need one and don't already have one.  */
-
-  /* First try to decide what to do without reference to lookahead token.  */
-  yyn = yypact[yystate];
-  if (yypact_value_is_default (yyn))
-    goto yydefault;
-
-  /* Not known => get a lookahead token if don't already have one.  */
-
-  /* YYCHAR is either empty, or end-of-input, or a valid lookahead.  */
-  if (yychar == YYEMPTY)
-    {
-      YYDPRINTF ((stderr, "Reading a token\n"));
-      yychar = yylex ();
-    }
-
-  if (yychar <= YYEOF)
-    {
-      yychar = YYEOF;
-      yytoken = YYSYMBOL_YYEOF;
-      YYDPRINTF ((stderr, "Now at end of input.\n"));
-    }
-  else if (yychar == YYerror)
-    {
-      /* The scanner already issued an error message, process directly
-         to error recovery.  But do not keep the error token as
-         lookahead, it is too special and may lead us to an endless
-         loop in error recovery. */
-      yychar = YYUNDEF;
-      yytoken = YYSYMBOL_YYerror;
-      goto yyerrlab1;
-    }
-  else
-    {
-      yytoken = YYTRANSLATE (yychar);
-      YY_SYMBOL_PRINT ("Next token is", yytoken, &yylval, &yylloc);
-    }
-
-  /* If the proper action on seeing token YYTOKEN is to reduce or to
-     detect an error, take that action.  */
-  yyn += yytoken;
-  if (yyn < 0 || YYLAST < yyn || yycheck[yyn] != yytoken)
-    goto yydefault;
-  yyn = yytable[yyn];
-  if (yyn <= 0)
-    {
-      if (yytable_value_is_error (yyn))
-        goto yyerrlab;
-      yyn = -yyn;
-      goto yyreduce;
-    }
-
-  /* Count tokens shifted since error; after three, turn off error
-     status.  */
-  if (yyerrstatus)
-    yyerrstatus--;
-
-  /* Shift the lookahead token.  */
-  YY_SYMBOL_PRINT ("Shifting", yytoken, &yylval, &yylloc);
-  yystate = yyn;
-  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-  *++yyvsp = yylval;
-  YY_IGNORE_MAYBE_UNINITIALIZED_END
-
-  /* Discard the shifted token.  */
-  yychar = YYEMPTY;
-  goto yynewstate;
-
-
-/*-----------------------------------------------------------.
-| yydefault -- do the default action for the current state.  |
-`-----------------------------------------------------------*/
-yydefault:
-  yyn = yydefact[yystate];
-  if (yyn == 0)
-    goto yyerrlab;
-  goto yyreduce;
-
-
-/*-----------------------------.
-| yyreduce -- do a reduction.  |
-`-----------------------------*/
-yyreduce:
-  /* yyn is the number of a rule to reduce with.  */
-  yylen = yyr2[yyn];
-
-  /* If YYLEN is nonzero, implement the default value of the action:
-     '$$ = $1'.
-
-     Otherwise, the following line sets YYVAL to garbage.
-     This behavior is undocumented and Bison
-     users should not rely upon it.  Assigning to YYVAL
-     unconditionally makes the parser a bit smaller, and it avoids a
-     GCC warning that YYVAL may be used uninitialized.  */
-  yyval = yyvsp[1-yylen];
-
-
-  YY_REDUCE_PRINT (yyn);
-  switch (yyn)
-    {
-  case 2: /* program: stmts  */
-#line 353 "parser.y"
-      {
-          /* execute top-level statements after parsing */
-          execute_list((yyvsp[0].node));
-      }
-#line 1438 "parser.tab.c"
-    break;
-
-  case 3: /* stmts: %empty  */
-#line 361 "parser.y"
-                    { (yyval.node) = NULL; }
-#line 1444 "parser.tab.c"
-    break;
-
-  case 4: /* stmts: stmts stmt  */
-#line 362 "parser.y"
-                    {
-                        /* append stmt to list: if $1 == NULL return stmt as list node or create list node */
-                        if ((yyvsp[-1].node) == NULL) {
-                            /* treat single stmt as list (we still wrap it into a stmtlist node to be uniform) */
-                            (yyval.node) = new_stmtlist_node(NULL, (yyvsp[0].node));
-                        } else {
-                            (yyval.node) = new_stmtlist_node((yyvsp[-1].node), (yyvsp[0].node));
-                        }
-                    }
-#line 1458 "parser.tab.c"
-    break;
-
-  case 5: /* stmt: declaration  */
-#line 375 "parser.y"
-                   { (yyval.node) = (yyvsp[0].node); }
-#line 1464 "parser.tab.c"
-    break;
-
-  case 6: /* stmt: assignment  */
-#line 376 "parser.y"
-                   { (yyval.node) = (yyvsp[0].node); }
-#line 1470 "parser.tab.c"
-    break;
-
-  case 7: /* stmt: printStatement  */
-#line 377 "parser.y"
-                     { (yyval.node) = (yyvsp[0].node); }
-#line 1476 "parser.tab.c"
-    break;
-
-  case 8: /* stmt: IfStatement  */
-#line 378 "parser.y"
-                   { (yyval.node) = (yyvsp[0].node); }
-#line 1482 "parser.tab.c"
-    break;
-
-  case 9: /* stmt: expr ';'  */
-#line 379 "parser.y"
-                   { /* expression statement: evaluate at execution time; wrap as a print of value? we keep it as an expr node to be executed as printing its value */
-                      /* We'll wrap it in a print-like node to keep execution consistent: a "printexpr" -> we'll use N_PRINT with left = expr */
-                      (yyval.node) = new_print_node((yyvsp[-1].node));
-                    }
-#line 1491 "parser.tab.c"
-    break;
-
-  case 10: /* declaration: INT VARIABLE '=' expr ';'  */
-#line 388 "parser.y"
-      {
-          /* var node with id */
-          Node *varNode = new_var_node((yyvsp[-3].ival));
-          Node *dec = new_decl_node(varNode, (yyvsp[-1].node));
-          (yyval.node) = dec;
-      }
-#line 1502 "parser.tab.c"
-    break;
-
-  case 11: /* assignment: VARIABLE '=' expr ';'  */
-#line 399 "parser.y"
-      {
-          Node *varNode = new_var_node((yyvsp[-3].ival));
-          Node *asn = new_assign_node(varNode, (yyvsp[-1].node));
-          (yyval.node) = asn;
-      }
-#line 1512 "parser.tab.c"
-    break;
-
-  case 12: /* printStatement: PRINT '(' expr ')' ';'  */
-#line 409 "parser.y"
-      {
-          Node *p = new_print_node((yyvsp[-2].node));
-          (yyval.node) = p;
-      }
-#line 1521 "parser.tab.c"
-    break;
-
-  case 13: /* IfStatement: IF '(' condition ')' ':' block ELSE ':' block END  */
-#line 418 "parser.y"
-      {
-          Node *ifn = new_if_node((yyvsp[-7].node), (yyvsp[-4].node), (yyvsp[-1].node));
-          (yyval.node) = ifn;
-      }
-#line 1530 "parser.tab.c"
-    break;
-
-  case 14: /* IfStatement: IF '(' condition ')' ':' block END  */
-#line 423 "parser.y"
-      {
-          Node *ifn = new_if_node((yyvsp[-4].node), (yyvsp[-1].node), NULL);
-          (yyval.node) = ifn;
-      }
-#line 1539 "parser.tab.c"
-    break;
-
-  case 15: /* block: stmts  */
-#line 432 "parser.y"
-      {
-          (yyval.node) = (yyvsp[0].node);  /* block is simply the stmtlist produced */
-      }
-#line 1547 "parser.tab.c"
-    break;
-
-  case 16: /* condition: expr OP expr  */
-#line 440 "parser.y"
-      {
-          /* OP is a string (lexer must strdup) */
-          (yyval.node) = new_op_node((yyvsp[-1].sval), (yyvsp[-2].node), (yyvsp[0].node));
-          /* We do not evaluate now; evaluation happens at run-time via eval_expr */
-          free((yyvsp[-1].sval)); /* free strdup from lexer to avoid leak */
-      }
-#line 1558 "parser.tab.c"
-    break;
-
-  case 17: /* expr: INTEGER  */
-#line 451 "parser.y"
-      {
-          (yyval.node) = new_int_node((yyvsp[0].ival));
-      }
-#line 1566 "parser.tab.c"
-    break;
-
-  case 18: /* expr: VARIABLE  */
-#line 455 "parser.y"
-      {
-          (yyval.node) = new_var_node((yyvsp[0].ival));
-      }
-#line 1574 "parser.tab.c"
-    break;
-
-  case 19: /* expr: expr '+' expr  */
-#line 459 "parser.y"
-      {
-          (yyval.node) = new_op_node("+", (yyvsp[-2].node), (yyvsp[0].node));
-      }
-#line 1582 "parser.tab.c"
-    break;
-
-  case 20: /* expr: expr '-' expr  */
-#line 463 "parser.y"
-      {
-          (yyval.node) = new_op_node("-", (yyvsp[-2].node), (yyvsp[0].node));
-      }
-#line 1590 "parser.tab.c"
-    break;
-
-  case 21: /* expr: expr '*' expr  */
-#line 467 "parser.y"
-      {
-          (yyval.node) = new_op_node("*", (yyvsp[-2].node), (yyvsp[0].node));
-      }
-#line 1598 "parser.tab.c"
-    break;
-
-  case 22: /* expr: expr '/' expr  */
-#line 471 "parser.y"
-      {
-          (yyval.node) = new_op_node("/", (yyvsp[-2].node), (yyvsp[0].node));
-      }
-#line 1606 "parser.tab.c"
-    break;
-
-  case 23: /* expr: '(' expr ')'  */
-#line 475 "parser.y"
-      {
-          (yyval.node) = (yyvsp[-1].node);
-      }
-#line 1614 "parser.tab.c"
-    break;
-
-
-#line 1618 "parser.tab.c"
-
-      default: break;
-    }
-  /* User semantic actions sometimes alter yychar, and that requires
-     that yytoken be updated with the new translation.  We take the
-     approach of translating immediately before every use of yytoken.
-     One alternative is translating here after every semantic action,
-     but that translation would be missed if the semantic action invokes
-     YYABORT, YYACCEPT, or YYERROR immediately after altering yychar or
-     if it invokes YYBACKUP.  In the case of YYABORT or YYACCEPT, an
-     incorrect destructor might then be invoked immediately.  In the
-     case of YYERROR or YYBACKUP, subsequent parser actions might lead
-     to an incorrect destructor call or verbose syntax error message
-     before the lookahead is translated.  */
-  YY_SYMBOL_PRINT ("-> $$ =", YY_CAST (yysymbol_kind_t, yyr1[yyn]), &yyval, &yyloc);
-
-  YYPOPSTACK (yylen);
-  yylen = 0;
-
-  *++yyvsp = yyval;
-
-  /* Now 'shift' the result of the reduction.  Determine what state
-     that goes to, based on the state we popped back to and the rule
-     number reduced by.  */
-  {
-    const int yylhs = yyr1[yyn] - YYNTOKENS;
-    const int yyi = yypgoto[yylhs] + *yyssp;
-    yystate = (0 <= yyi && yyi <= YYLAST && yycheck[yyi] == *yyssp
-               ? yytable[yyi]
-               : yydefgoto[yylhs]);
-  }
-
-  goto yynewstate;
-
-
-/*--------------------------------------.
-| yyerrlab -- here on detecting error.  |
-`--------------------------------------*/
-yyerrlab:
-  /* Make sure we have latest lookahead translation.  See comments at
-     user semantic actions for why this is necessary.  */
-  yytoken = yychar == YYEMPTY ? YYSYMBOL_YYEMPTY : YYTRANSLATE (yychar);
-  /* If not already recovering from an error, report this error.  */
-  if (!yyerrstatus)
-    {
-      ++yynerrs;
-      yyerror (YY_("syntax error"));
-    }
-
-  if (yyerrstatus == 3)
-    {
-      /* If just tried and failed to reuse lookahead token after an
-         error, discard it.  */
-
-      if (yychar <= YYEOF)
-        {
-          /* Return failure if at end of input.  */
-          if (yychar == YYEOF)
-            YYABORT;
-        }
-      else
-        {
-          yydestruct ("Error: discarding",
-                      yytoken, &yylval);
-          yychar = YYEMPTY;
-        }
-    }
-
-  /* Else will try to reuse lookahead token after shifting the error
-     token.  */
-  goto yyerrlab1;
-
-
-/*---------------------------------------------------.
-| yyerrorlab -- error raised explicitly by YYERROR.  |
-`---------------------------------------------------*/
-yyerrorlab:
-  /* Pacify compilers when the user code never invokes YYERROR and the
-     label yyerrorlab therefore never appears in user code.  */
-  if (0)
-    YYERROR;
-  ++yynerrs;
-
-  /* Do not reclaim the symbols of the rule whose action triggered
-     this YYERROR.  */
-  YYPOPSTACK (yylen);
-  yylen = 0;
-  YY_STACK_PRINT (yyss, yyssp);
-  yystate = *yyssp;
-  goto yyerrlab1;
-
-
-/*-------------------------------------------------------------.
-| yyerrlab1 -- common code for both syntax error and YYERROR.  |
-`-------------------------------------------------------------*/
-yyerrlab1:
-  yyerrstatus = 3;      /* Each real token shifted decrements this.  */
-
-  /* Pop stack until we find a state that shifts the error token.  */
-  for (;;)
-    {
-      yyn = yypact[yystate];
-      if (!yypact_value_is_default (yyn))
-        {
-          yyn += YYSYMBOL_YYerror;
-          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYSYMBOL_YYerror)
-            {
-              yyn = yytable[yyn];
-              if (0 < yyn)
-                break;
-            }
-        }
-
-      /* Pop the current state because it cannot handle the error token.  */
-      if (yyssp == yyss)
-        YYABORT;
-
-
-      yydestruct ("Error: popping",
-                  YY_ACCESSING_SYMBOL (yystate), yyvsp);
-      YYPOPSTACK (1);
-      yystate = *yyssp;
-      YY_STACK_PRINT (yyss, yyssp);
-    }
-
-  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-  *++yyvsp = yylval;
-  YY_IGNORE_MAYBE_UNINITIALIZED_END
-
-
-  /* Shift the error token.  */
-  YY_SYMBOL_PRINT ("Shifting", YY_ACCESSING_SYMBOL (yyn), yyvsp, yylsp);
-
-  yystate = yyn;
-  goto yynewstate;
-
-
-/*-------------------------------------.
-| yyacceptlab -- YYACCEPT comes here.  |
-`-------------------------------------*/
-yyacceptlab:
-  yyresult = 0;
-  goto yyreturnlab;
-
-
-/*-----------------------------------.
-| yyabortlab -- YYABORT comes here.  |
-`-----------------------------------*/
-yyabortlab:
-  yyresult = 1;
-  goto yyreturnlab;
-
-
-/*-----------------------------------------------------------.
-| yyexhaustedlab -- YYNOMEM (memory exhaustion) comes here.  |
-`-----------------------------------------------------------*/
-yyexhaustedlab:
-  yyerror (YY_("memory exhausted"));
-  yyresult = 2;
-  goto yyreturnlab;
-
-
-/*----------------------------------------------------------.
-| yyreturnlab -- parsing is finished, clean up and return.  |
-`----------------------------------------------------------*/
-yyreturnlab:
-  if (yychar != YYEMPTY)
-    {
-      /* Make sure we have latest lookahead translation.  See comments at
-         user semantic actions for why this is necessary.  */
-      yytoken = YYTRANSLATE (yychar);
-      yydestruct ("Cleanup: discarding lookahead",
-                  yytoken, &yylval);
-    }
-  /* Do not reclaim the symbols of the rule whose action triggered
-     this YYABORT or YYACCEPT.  */
-  YYPOPSTACK (yylen);
-  YY_STACK_PRINT (yyss, yyssp);
-  while (yyssp != yyss)
-    {
-      yydestruct ("Cleanup: popping",
-                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp);
-      YYPOPSTACK (1);
-    }
-#ifndef yyoverflow
-  if (yyss != yyssa)
-    YYSTACK_FREE (yyss);
-#endif
-
-  return yyresult;
-}
-
-#line 480 "parser.y"
-
-
-/* error reporting */
-void yyerror(char *s) {
-    if (!yyError) yyError = stderr;
-    fprintf(yyError, "Error: %s at line %d\n", s, yylineno);
-}
-
-/* main: open files and run parser */
-int main(void) {
-    yyin = fopen("in.txt", "r");
-    yyout = fopen("out.txt", "w");
-    yytree = fopen("tree.txt", "w");
-    yyError = fopen("outError.txt", "w");
-
-    if (!yyin) { perror("open in.txt"); return 1; }
-    if (!yyout) { perror("open out.txt"); return 1; }
-    if (!yytree) { perror("open tree.txt"); return 1; }
-
-
-    // initialize symbol table
-    for(int i = 0; i < 256; i++) {
-        sym[i] = 0;
-        declared[i] = 0;
-    }
-
-    yyparse();
-
-    fclose(yyin);
-    fclose(yyout);
-    fclose(yytree);
-    if (yyError && yyError != stderr) fclose(yyError);
-    return 0;
-}
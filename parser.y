@@ -1,10 +1,10 @@
-%{
+%code {
 /*
   parser.y — Statements & correct if/else execution
 
   Behaviors:
   - Build statement trees during parsing (no execution during parse)
-  - After parsing the whole program, execute top-level statements (program -> stmts { execute_list($1); })
+  - After parsing the whole program, main() executes the top-level statements (program -> stmts, kept in program_root)
   - Blocks inside if/else are kept as stmt-lists and only executed according to condition
   - Printing of parse-trees goes to tree.txt at execution time
   - Runtime outputs (Declared..., Assigned..., Print...) go to out.txt
@@ -12,24 +12,175 @@
 */
 
 #include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <limits.h>
 #include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <malloc.h>
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 int yylex(void);
 void yyerror(char *);
-void semantic_error(const char *msg, int line);
+void error_at(const char *msg, uint32_t offset);
+void offset_to_line_col(uint32_t offset, int *line, int *col);  /* scanner.l */
+const char *variable_name(int id);      /* scanner.l */
+unsigned char *read_input(FILE *f, size_t *len);   /* scanner.l */
 
-extern int yylineno;
 extern FILE* yyin;
 extern FILE* yyout;
 FILE* yytree = NULL;
 FILE* yyError = NULL;
 
-/* symbol table: variables are represented by integer IDs provided by scanner */
-int sym[256];
-int declared[256]; /* track declared variables */
+void semantic_error(const char *msg, NodeId stmt);
+void semantic_error_at(const char *msg, NodeId stmt, NodeId use);
+void diag_flush(FILE *f);
+extern int diag_format;
+double now_seconds(void);
 
-int runtime_error = 0;
+NodeId program_root = 0;  /* top-level statement list, set when parsing succeeds */
+
+/* ---- portability ----
+   The POSIX calls that MinGW (run.bat) lacks, with their Windows
+   counterparts. -metrics needs POSIX sockets and is refused on Windows. */
+static void *alloc_aligned(size_t align, size_t size) {
+#ifdef _WIN32
+    return _aligned_malloc(size, align);
+#else
+    return aligned_alloc(align, size);
+#endif
+}
+
+static void free_aligned(void *p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+static int make_dir(const char *path) {
+#ifdef _WIN32
+    return _mkdir(path);
+#else
+    return mkdir(path, 0777);
+#endif
+}
+
+/* absolute path of an existing file (malloc'd); NULL if there is none */
+static char *real_path(const char *path) {
+#ifdef _WIN32
+    struct stat st;
+    char *full = _fullpath(NULL, path, 0);
+    if (full && stat(full, &st) != 0) {
+        free(full);
+        full = NULL;
+    }
+    return full;
+#else
+    return realpath(path, NULL);
+#endif
+}
+
+/* Windows paths may use '\\' as well as '/', and X:\... is absolute */
+static int is_path_sep(char c) {
+#ifdef _WIN32
+    return c == '/' || c == '\\';
+#else
+    return c == '/';
+#endif
+}
+
+static int path_is_absolute(const char *path, size_t len) {
+#ifdef _WIN32
+    if (len >= 3 && ((path[0] | 32) >= 'a' && (path[0] | 32) <= 'z') && path[1] == ':' && is_path_sep(path[2]))
+        return 1;
+#endif
+    return len && is_path_sep(path[0]);
+}
+
+/* cut path down to its directory in place: "." if it has none, the
+   separator itself for a file in the root */
+static void path_dirname(char *path) {
+    char *sep = NULL;
+    for (char *p = path; *p; p++)
+        if (is_path_sep(*p)) sep = p;
+    if (!sep) strcpy(path, ".");
+    else if (sep == path) path[1] = '\0';
+    else *sep = '\0';
+}
+
+/* CPUs online; 0 if unknown */
+static unsigned cpu_count(void) {
+#ifdef _WIN32
+    const char *n = getenv("NUMBER_OF_PROCESSORS");
+    return n ? (unsigned)atoi(n) : 0;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned)n : 0;
+#else
+    return 0;
+#endif
+}
+
+/* ---- memory limits ----
+   Memory is capped per program (-max-memory) by accounting in the
+   allocators rather than by the OS: every allocation made for a program
+   is charged to its MemLimit first. That covers AST nodes and statement
+   locations while it is parsed (mem_current), the packed token buffer,
+   and its execution stack and buffered output while it runs (Exec.mem).
+   The identifier table is a fixed array and needs no charge. A refused
+   charge fails the program with "Memory limit exceeded" instead of
+   growing the process. */
+MemLimit *mem_current = NULL;   /* program being parsed (NULL: not accounted) */
+
+int mem_charge(MemLimit *m, size_t bytes) {
+    if (!m) return 1;
+    if (atomic_load_explicit(&m->exceeded, memory_order_relaxed)) return 0;
+    size_t before = atomic_fetch_add_explicit(&m->used, bytes, memory_order_relaxed);
+    if (m->limit && before + bytes > m->limit) {
+        atomic_fetch_sub_explicit(&m->used, bytes, memory_order_relaxed);
+        atomic_store_explicit(&m->exceeded, 1, memory_order_relaxed);
+        return 0;
+    }
+    return 1;
+}
+
+/* charge bytes if the program has room for them; unlike mem_charge(), a
+   refusal does not fail the program (for caches it can do without) */
+int mem_charge_spare(MemLimit *m, size_t bytes) {
+    if (m && m->limit && atomic_load_explicit(&m->used, memory_order_relaxed) + bytes > m->limit)
+        return 0;
+    return mem_charge(m, bytes);
+}
+
+/* allocations made while parsing: the first refused charge is reported at
+   the token being parsed and yylex() then ends the parse */
+static void compile_charge(size_t bytes) {
+    if (mem_current && !atomic_load_explicit(&mem_current->exceeded, memory_order_relaxed)
+        && !mem_charge(mem_current, bytes))
+        error_at("Memory limit exceeded", yylloc.first);
+}
+
+struct Pipeline;
+extern struct Pipeline *pipe_state;   /* non-NULL while running with -pipeline */
+void pipeline_emit(NodeId stmt);
 
 /* Node kinds */
 enum {
@@ -42,472 +193,5796 @@ enum {
     N_PRINT,    /* print */
     N_IF,       /* if */
     N_BRANCHES, /* helper node with then/else as children */
-    N_STMTLIST  /* linked list tree of statements: left = previous list, right = stmt */
+    N_STMTLIST, /* linked list tree of statements: left = previous list, right = stmt */
+    N_INDEX,    /* map lookup m[k]: left = map variable, right = key */
+    N_MAPDECL,  /* map declaration: left = variable */
+    N_MAPSET,   /* m[k] = e: left = index node, right = value */
+    N_MAPDEL,   /* delete m[k]: left = index node */
+    N_WHILE,    /* while: left = condition, right = body list, value = its N_LOOP */
+    N_LOOP,     /* back edge of a while, run after each pass: left = the while */
+    N_TRAP,     /* statement patched by the debugger, see trap_set() */
+    N_SWITCH,   /* if/else chain lowered by -O: value = index in switch_table */
+    N_HOISTED,  /* loop-invariant expression (-O): left = it, value = its slot */
+    N_CONST,    /* expression with a value known before running (-O): left = it */
+    N_IMPORT    /* import, only while parsing: value = module (in an image: its file) */
 };
 
-/* ---- Node definition ---- */
-typedef struct Node {
-    char *label;          /* human-readable label (operator or node name) */
-    struct Node *left;
-    struct Node *right;
-    int kind;
-    int int_value;        /* for integer literal */
-    int var_id;           /* for variable nodes */
-    int line;
-} Node;
+static const char *op_names[] = { "", "+", "-", "*", "/", "==", "!=", "<=", ">=", "<", ">" };
+
+/* labels printed in tree.txt for the non-leaf kinds */
+static const char *kind_labels[] = {
+    "", "", "", "", "dec", "assign", "print", "if", "branches", "stmtlist",
+    "[]", "map", "assign", "delete", "while", ""
+};
+
+/* map an operator string from the lexer ("==", "<", ...) to its op code */
+int op_from_string(const char *s) {
+    for (int i = OP_ADD; i <= OP_GT; i++)
+        if (strcmp(op_names[i], s) == 0) return i;
+    return OP_NONE;
+}
+
+/* ---- AST storage ----
+   Nodes live in parallel arrays (structure of arrays) and are addressed by a
+   32-bit NodeId; id 0 is the null node. The arrays are split into fixed-size
+   chunks so a node never moves once created: ids stay valid while the tree
+   grows, and a walk touches only the arrays it needs (e.g. eval reads kind/op/
+   lhs/rhs/value only). Source locations are kept in a side table, see
+   loc_record(). */
+#define AST_CHUNK_BITS 12
+#define AST_CHUNK_SIZE (1u << AST_CHUNK_BITS)
+#define AST_CHUNK_MASK (AST_CHUNK_SIZE - 1)
+#define AST_MAX_CHUNKS 16384            /* 64M nodes */
+
+typedef struct AstChunk {
+    uint8_t  kind[AST_CHUNK_SIZE];
+    uint8_t  op[AST_CHUNK_SIZE];
+    NodeId   lhs[AST_CHUNK_SIZE];
+    NodeId   rhs[AST_CHUNK_SIZE];
+    int32_t  value[AST_CHUNK_SIZE];     /* literal value, or variable id for N_VAR */
+} AstChunk;
+
+AstChunk *ast_chunks[AST_MAX_CHUNKS];
+NodeId ast_count = 1;                   /* next free id (0 is reserved as null) */
+
+#define AST_KIND(n)  (ast_chunks[(n) >> AST_CHUNK_BITS]->kind[(n) & AST_CHUNK_MASK])
+#define AST_OP(n)    (ast_chunks[(n) >> AST_CHUNK_BITS]->op[(n) & AST_CHUNK_MASK])
+#define AST_LHS(n)   (ast_chunks[(n) >> AST_CHUNK_BITS]->lhs[(n) & AST_CHUNK_MASK])
+#define AST_RHS(n)   (ast_chunks[(n) >> AST_CHUNK_BITS]->rhs[(n) & AST_CHUNK_MASK])
+#define AST_VALUE(n) (ast_chunks[(n) >> AST_CHUNK_BITS]->value[(n) & AST_CHUNK_MASK])
+
+/* bytes of one node in the arrays above, charged to the program that creates it */
+#define AST_NODE_BYTES (2 * sizeof(uint8_t) + 2 * sizeof(NodeId) + sizeof(int32_t))
 
 /* helpers to create nodes */
-Node* new_node_kind(const char *label, int kind, Node *left, Node *right) {
-    Node *n = (Node*)malloc(sizeof(Node));
-    if (!n) { perror("malloc"); exit(1); }
-    n->label = strdup(label ? label : "");
-    n->left = left;
-    n->right = right;
-    n->kind = kind;
-    n->int_value = 0;
-    n->var_id = -1;
-    n->line = yylineno;
+NodeId new_node_kind(int kind, int op, NodeId left, NodeId right, int value) {
+    NodeId n = ast_count;
+    unsigned c = n >> AST_CHUNK_BITS;
+    if (c >= AST_MAX_CHUNKS) { fprintf(stderr, "AST too large\n"); exit(1); }
+    if (!ast_chunks[c]) {
+        ast_chunks[c] = (AstChunk*)malloc(sizeof(AstChunk));
+        if (!ast_chunks[c]) { perror("malloc"); exit(1); }
+    }
+    ast_count++;
+    compile_charge(AST_NODE_BYTES);
+    AST_KIND(n) = (uint8_t)kind;
+    AST_OP(n) = (uint8_t)op;
+    AST_LHS(n) = left;
+    AST_RHS(n) = right;
+    AST_VALUE(n) = value;
     return n;
 }
 
-Node* new_int_node(int v) {
-    Node *n = new_node_kind(NULL, N_INT, NULL, NULL);
-    {
-        char buf[64];
-        sprintf(buf, "INTEGER(%d)", v);
-        free(n->label);
-        n->label = strdup(buf);
+/* ---- hash-consing of expression nodes ----
+   Structurally equal expressions (same kind, op, children and value) are
+   created only once, so expressions form a DAG: repeated literals, variables
+   and subexpressions such as (a + b) share a single node. Expression nodes are
+   never modified after creation, which makes the sharing safe, and a pass can
+   treat equal NodeIds as equal values. A shared node has no single source
+   location, so the places it is used are recorded per statement (see
+   use_record). */
+NodeId *hc_table = NULL;    /* open addressing, linear probing; 0 = empty slot */
+uint32_t hc_cap = 0;        /* power of two */
+uint32_t hc_used = 0;
+
+static uint32_t hc_hash(int kind, int op, NodeId l, NodeId r, int value) {
+    uint32_t h = 2166136261u;
+    h = (h ^ (uint32_t)kind) * 16777619u;
+    h = (h ^ (uint32_t)op) * 16777619u;
+    h = (h ^ l) * 16777619u;
+    h = (h ^ r) * 16777619u;
+    h = (h ^ (uint32_t)value) * 16777619u;
+    return h ^ (h >> 15);
+}
+
+static void hc_grow(void) {
+    uint32_t cap = hc_cap ? hc_cap * 2 : 1024;
+    NodeId *t = (NodeId*)calloc(cap, sizeof(NodeId));
+    if (!t) { perror("calloc"); exit(1); }
+    for (uint32_t i = 0; i < hc_cap; i++) {
+        NodeId n = hc_table[i];
+        if (!n) continue;
+        uint32_t j = hc_hash(AST_KIND(n), AST_OP(n), AST_LHS(n), AST_RHS(n), AST_VALUE(n)) & (cap - 1);
+        while (t[j]) j = (j + 1) & (cap - 1);
+        t[j] = n;
+    }
+    free(hc_table);
+    hc_table = t;
+    hc_cap = cap;
+}
+
+NodeId hashcons_node(int kind, int op, NodeId l, NodeId r, int value) {
+    if (2 * (hc_used + 1) > hc_cap) hc_grow();
+    uint32_t i = hc_hash(kind, op, l, r, value) & (hc_cap - 1);
+    for (NodeId n; (n = hc_table[i]) != 0; i = (i + 1) & (hc_cap - 1)) {
+        if (AST_KIND(n) == kind && AST_OP(n) == op && AST_LHS(n) == l &&
+            AST_RHS(n) == r && AST_VALUE(n) == value)
+            return n;
     }
-    n->int_value = v;
+    NodeId n = new_node_kind(kind, op, l, r, value);
+    hc_table[i] = n;
+    hc_used++;
     return n;
 }
 
-Node* new_var_node(int id) {
-    Node *n = new_node_kind(NULL, N_VAR, NULL, NULL);
-    {
-        char buf[64];
-        sprintf(buf, "VAR(id=%d)", id);
-        free(n->label);
-        n->label = strdup(buf);
+NodeId new_int_node(int v) {
+    return hashcons_node(N_INT, OP_NONE, 0, 0, v);
+}
+
+NodeId new_var_node(int id) {
+    return hashcons_node(N_VAR, OP_NONE, 0, 0, id);
+}
+
+NodeId new_op_node(int op, NodeId l, NodeId r) {
+    return hashcons_node(N_OP, op, l, r, 0);
+}
+
+NodeId new_index_node(NodeId varNode, NodeId keyNode) {
+    return hashcons_node(N_INDEX, OP_NONE, varNode, keyNode, 0);
+}
+
+NodeId new_decl_node(NodeId varNode, NodeId exprNode) {
+    return new_node_kind(N_DECL, OP_NONE, varNode, exprNode, 0);
+}
+
+NodeId new_assign_node(NodeId varNode, NodeId exprNode) {
+    return new_node_kind(N_ASSIGN, OP_NONE, varNode, exprNode, 0);
+}
+
+NodeId new_print_node(NodeId exprNode) {
+    return new_node_kind(N_PRINT, OP_NONE, exprNode, 0, 0);
+}
+
+NodeId new_map_decl_node(NodeId varNode) {
+    return new_node_kind(N_MAPDECL, OP_NONE, varNode, 0, 0);
+}
+
+NodeId new_map_set_node(NodeId indexNode, NodeId exprNode) {
+    return new_node_kind(N_MAPSET, OP_NONE, indexNode, exprNode, 0);
+}
+
+NodeId new_map_delete_node(NodeId indexNode) {
+    return new_node_kind(N_MAPDEL, OP_NONE, indexNode, 0, 0);
+}
+
+/* the if node is created as soon as its condition is parsed, before the
+   statements of its blocks (keeping loc_table sorted); the branches are
+   attached at END */
+NodeId new_if_node(NodeId cond) {
+    return new_node_kind(N_IF, OP_NONE, cond, 0, 0);
+}
+
+NodeId finish_if_node(NodeId ifNode, NodeId thenList, NodeId elseList) {
+    AST_RHS(ifNode) = new_node_kind(N_BRANCHES, OP_NONE, thenList, elseList, 0);
+    return ifNode;
+}
+
+/* like an if, the while node is created before its body is parsed; its
+   N_LOOP node is the statement pushed to test the condition again */
+NodeId new_while_node(NodeId cond) {
+    return new_node_kind(N_WHILE, OP_NONE, cond, 0, 0);
+}
+
+NodeId finish_while_node(NodeId whileNode, NodeId body) {
+    AST_RHS(whileNode) = body;
+    AST_VALUE(whileNode) = (int)new_node_kind(N_LOOP, OP_NONE, whileNode, 0, 0);
+    return whileNode;
+}
+
+NodeId new_stmtlist_node(NodeId prevList, NodeId stmt) {
+    return new_node_kind(N_STMTLIST, OP_NONE, prevList, stmt, 0);
+}
+
+NodeId new_import_node(int module, uint32_t offset);   /* modules, after the grammar */
+NodeId append_stmt(NodeId list, NodeId stmt);
+
+/* ---- statement locations ----
+   Nodes do not store a line. Statements record the byte offset where they
+   start in this side table; line and column are derived from the offset
+   only when a diagnostic is printed (offset_to_line_col in scanner.l).
+   Statements are created in increasing NodeId order, so the table stays
+   sorted and is searched with a binary search. */
+typedef struct LocEntry {
+    NodeId node;
+    uint32_t offset;
+} LocEntry;
+
+LocEntry *loc_table = NULL;
+uint32_t loc_count = 0, loc_cap = 0;
+
+/* Runtime errors in an expression are located at the use that failed: a
+   variable, a map lookup or a division. An expression node may be used in
+   many statements, so a use is keyed by statement and node. The parser
+   collects the uses of the statement being parsed in use_pending and
+   loc_record enters them in use_table; where -O rebuilds an expression
+   node, the new node takes the offset of the old one (use_copy). The
+   first use of a node in a statement is kept: it is also the one
+   evaluated first. */
+typedef struct UseEntry {
+    NodeId stmt, node;      /* stmt 0: empty slot */
+    uint32_t offset;
+} UseEntry;
+
+UseEntry *use_table = NULL;     /* open addressing, linear probing */
+uint32_t use_cap = 0, use_used = 0;
+UseEntry *use_pending = NULL;   /* uses of the statement being parsed */
+uint32_t use_pending_count = 0, use_pending_cap = 0;
+
+static uint32_t use_hash(NodeId stmt, NodeId node) {
+    uint64_t k = ((uint64_t)stmt << 32 | node) * 0x9E3779B97F4A7C15ull;
+    return (uint32_t)(k >> 32);
+}
+
+static UseEntry *use_slot(NodeId stmt, NodeId node) {
+    uint32_t i = use_hash(stmt, node) & (use_cap - 1);
+    while (use_table[i].stmt && (use_table[i].stmt != stmt || use_table[i].node != node))
+        i = (i + 1) & (use_cap - 1);
+    return &use_table[i];
+}
+
+static void use_insert(NodeId stmt, NodeId node, uint32_t offset) {
+    if (4 * (use_used + 1) > 3 * use_cap) {
+        UseEntry *old = use_table;
+        uint32_t cap = use_cap;
+        use_cap = use_cap ? use_cap * 2 : 256;
+        use_table = (UseEntry*)calloc(use_cap, sizeof(UseEntry));
+        if (!use_table) { perror("calloc"); exit(1); }
+        for (uint32_t i = 0; i < cap; i++)
+            if (old[i].stmt) *use_slot(old[i].stmt, old[i].node) = old[i];
+        free(old);
+    }
+    UseEntry *e = use_slot(stmt, node);
+    if (e->stmt) return;
+    compile_charge(sizeof(UseEntry));
+    e->stmt = stmt;
+    e->node = node;
+    e->offset = offset;
+    use_used++;
+}
+
+/* note a use of expression node n at offset in the statement being parsed */
+NodeId use_record(NodeId n, uint32_t offset) {
+    if (use_pending_count == use_pending_cap) {
+        use_pending_cap = use_pending_cap ? use_pending_cap * 2 : 64;
+        use_pending = (UseEntry*)realloc(use_pending, use_pending_cap * sizeof(UseEntry));
+        if (!use_pending) { perror("realloc"); exit(1); }
     }
-    n->var_id = id;
+    use_pending[use_pending_count].node = n;
+    use_pending[use_pending_count].offset = offset;
+    use_pending_count++;
     return n;
 }
 
-Node* new_op_node(const char *op, Node *l, Node *r) {
-    Node *n = new_node_kind(op, N_OP, l, r);
+/* source offset of the use of node in stmt; 0 if there is none */
+uint32_t use_offset(NodeId stmt, NodeId node) {
+    if (!use_cap || !stmt || !node) return 0;
+    UseEntry *e = use_slot(stmt, node);
+    return e->stmt ? e->offset : 0;
+}
+
+/* -O replaced node from by node to in stmt */
+void use_copy(NodeId stmt, NodeId from, NodeId to) {
+    uint32_t offset = use_offset(stmt, from);
+    if (offset && from != to) use_insert(stmt, to, offset);
+}
+
+NodeId loc_record(NodeId n, uint32_t offset) {
+    for (uint32_t i = 0; i < use_pending_count; i++)
+        use_insert(n, use_pending[i].node, use_pending[i].offset);
+    use_pending_count = 0;
+    if (loc_count == loc_cap) {
+        loc_cap = loc_cap ? loc_cap * 2 : 256;
+        loc_table = (LocEntry*)realloc(loc_table, loc_cap * sizeof(LocEntry));
+        if (!loc_table) { perror("realloc"); exit(1); }
+    }
+    compile_charge(sizeof(LocEntry));
+    loc_table[loc_count].node = n;
+    loc_table[loc_count].offset = offset;
+    loc_count++;
     return n;
 }
 
-Node* new_decl_node(Node *varNode, Node *exprNode) {
-    return new_node_kind("dec", N_DECL, varNode, exprNode);
+/* source offset of a statement (0 if it has none) */
+uint32_t node_offset(NodeId n) {
+    uint32_t lo = 0, hi = loc_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (loc_table[mid].node < n) lo = mid + 1;
+        else hi = mid;
+    }
+    return (lo < loc_count && loc_table[lo].node == n) ? loc_table[lo].offset : 0;
+}
+
+void optimizer_free(void);
+
+/* drop the nodes created since ast_count was mark, with their locations
+   and hash-consing entries (a module parsed into an image, see
+   module_compile) */
+void ast_rollback(NodeId mark) {
+    NodeId *old = hc_table;
+    uint32_t cap = hc_cap;
+    ast_count = mark;
+    while (loc_count && loc_table[loc_count - 1].node >= mark) loc_count--;
+    use_pending_count = 0;
+    if (use_cap) {
+        UseEntry *uses = use_table;
+        uint32_t n = use_cap;
+        use_table = (UseEntry*)calloc(n, sizeof(UseEntry));
+        if (!use_table) { perror("calloc"); exit(1); }
+        use_used = 0;
+        for (uint32_t i = 0; i < n; i++)
+            if (uses[i].stmt && uses[i].stmt < mark && uses[i].node < mark) {
+                *use_slot(uses[i].stmt, uses[i].node) = uses[i];
+                use_used++;
+            }
+        free(uses);
+    }
+    hc_used = 0;
+    if (!cap) return;
+    hc_table = (NodeId*)calloc(cap, sizeof(NodeId));
+    if (!hc_table) { perror("calloc"); exit(1); }
+    for (uint32_t i = 0; i < cap; i++) {
+        NodeId n = old[i];
+        if (!n || n >= mark) continue;
+        uint32_t j = hc_hash(AST_KIND(n), AST_OP(n), AST_LHS(n), AST_RHS(n), AST_VALUE(n)) & (cap - 1);
+        while (hc_table[j]) j = (j + 1) & (cap - 1);
+        hc_table[j] = n;
+        hc_used++;
+    }
+    free(old);
+}
+
+/* release all node storage */
+void ast_free(void) {
+    for (unsigned c = 0; c < AST_MAX_CHUNKS && ast_chunks[c]; c++) {
+        free(ast_chunks[c]);
+        ast_chunks[c] = NULL;
+    }
+    ast_count = 1;
+    free(hc_table);
+    hc_table = NULL;
+    hc_cap = hc_used = 0;
+    free(loc_table);
+    loc_table = NULL;
+    loc_count = loc_cap = 0;
+    free(use_table);
+    free(use_pending);
+    use_table = use_pending = NULL;
+    use_cap = use_used = use_pending_count = use_pending_cap = 0;
+    optimizer_free();
+}
+
+/* ---- patched statements (debugger traps) ----
+   A breakpoint costs nothing while it is not hit. Setting one overwrites
+   the kind of the statement with N_TRAP, the way a debugger patches an
+   int3 over an instruction, and keeps the real kind here. Only a patched
+   statement reaches the debugger through execute_stmt's dispatch switch;
+   no flag is tested for the others. */
+enum { TRAP_BREAK = 1, TRAP_WATCH = 2, TRAP_STEP = 4 };
+
+typedef struct Trap {
+    NodeId stmt;
+    uint8_t kind;       /* the statement's real kind */
+    uint8_t flags;      /* TRAP_BREAK | TRAP_WATCH | TRAP_STEP */
+} Trap;
+
+Trap *trap_table = NULL;
+size_t trap_count = 0, trap_cap = 0;
+
+Trap *trap_find(NodeId stmt) {
+    for (size_t i = 0; i < trap_count; i++)
+        if (trap_table[i].stmt == stmt) return &trap_table[i];
+    return NULL;
 }
 
-Node* new_assign_node(Node *varNode, Node *exprNode) {
-    return new_node_kind("assign", N_ASSIGN, varNode, exprNode);
+/* real kind of a node, looking through a trap */
+int stmt_kind(NodeId n) {
+    if (AST_KIND(n) != N_TRAP) return AST_KIND(n);
+    return trap_find(n)->kind;
 }
 
-Node* new_print_node(Node *exprNode) {
-    return new_node_kind("print", N_PRINT, exprNode, NULL);
+void trap_set(NodeId stmt, int flag) {
+    Trap *t = trap_find(stmt);
+    if (!t) {
+        if (trap_count == trap_cap) {
+            trap_cap = trap_cap ? trap_cap * 2 : 16;
+            trap_table = (Trap*)realloc(trap_table, trap_cap * sizeof(Trap));
+            if (!trap_table) { perror("realloc"); exit(1); }
+        }
+        t = &trap_table[trap_count++];
+        t->stmt = stmt;
+        t->kind = AST_KIND(stmt);
+        t->flags = 0;
+        AST_KIND(stmt) = N_TRAP;
+    }
+    t->flags |= (uint8_t)flag;
 }
 
-Node* new_if_node(Node *cond, Node *thenList, Node *elseList) {
-    Node *branches = new_node_kind("branches", N_BRANCHES, thenList, elseList);
-    return new_node_kind("if", N_IF, cond, branches);
+void trap_clear(NodeId stmt, int flag) {
+    Trap *t = trap_find(stmt);
+    if (!t) return;
+    t->flags &= (uint8_t)~flag;
+    if (t->flags) return;
+    AST_KIND(stmt) = t->kind;
+    *t = trap_table[--trap_count];
 }
 
-Node* new_stmtlist_node(Node *prevList, Node *stmt) {
-    return new_node_kind("stmtlist", N_STMTLIST, prevList, stmt);
+/* source line of a statement; the test of a while again is on its line */
+static int stmt_line(NodeId stmt) {
+    int line, col;
+    if (stmt_kind(stmt) == N_LOOP) stmt = AST_LHS(stmt);
+    offset_to_line_col(node_offset(stmt), &line, &col);
+    return line;
 }
 
-/* free tree */
-void free_tree(Node *n) {
-    if (!n) return;
-    free_tree(n->left);
-    free_tree(n->right);
-    if (n->label) free(n->label);
-    free(n);
+/* human-readable label of a node (operator or node name), built on demand */
+const char *node_label(NodeId n, char *buf, size_t size) {
+    switch (AST_KIND(n)) {
+        case N_INT: snprintf(buf, size, "INTEGER(%d)", AST_VALUE(n)); return buf;
+        case N_VAR: snprintf(buf, size, "VAR(id=%d)", AST_VALUE(n)); return buf;
+        case N_OP:  return op_names[AST_OP(n)];
+        case N_TRAP: return kind_labels[stmt_kind(n)];
+        case N_SWITCH: return kind_labels[N_IF];
+        default:    return kind_labels[AST_KIND(n)];
+    }
 }
 
-/* ---- printing rotated vertical tree to yytree (like doctor style) ---- */
-void printTreeVertical(Node *root, int space) {
-    if (root == NULL) return;
+/* ---- output buffers ----
+   A running program writes its out.txt / tree.txt text into an OutBuf.
+   With a file attached the text is written out in large blocks; without
+   one it is kept in memory until the program finishes (-batch keeps
+   thousands of programs in flight and cannot hold a file open for each). */
+#define OUTBUF_FLUSH (64 * 1024)
 
-    if(root->kind == N_STMTLIST)
+typedef struct OutBuf {
+    char *data;
+    size_t len, cap;
+    FILE *file;     /* NULL: keep the text until out_flush() is given a file */
+    MemLimit *mem;  /* growth is charged here */
+    int full;       /* a charge was refused: later text is dropped */
+} OutBuf;
+
+void out_flush(OutBuf *b) {
+    if (b->file && b->len) fwrite(b->data, 1, b->len, b->file);
+    b->len = 0;
+}
+
+/* append len bytes of text */
+void out_write(OutBuf *b, const char *text, size_t len) {
+    if (b->cap - b->len <= len) {
+        size_t cap = b->cap ? b->cap * 2 : 4096;
+        while (cap - b->len <= len) cap *= 2;
+        if (!mem_charge(b->mem, cap - b->cap)) { b->full = 1; return; }
+        b->cap = cap;
+        b->data = (char*)realloc(b->data, b->cap);
+        if (!b->data) { perror("realloc"); exit(1); }
+    }
+    memcpy(b->data + b->len, text, len);
+    b->len += len;
+    if (b->file && b->len >= OUTBUF_FLUSH) out_flush(b);
+}
+
+void out_printf(OutBuf *b, const char *fmt, ...) {
+    va_list ap;
+    for (;;) {
+        size_t room = b->cap - b->len;
+        va_start(ap, fmt);
+        int n = vsnprintf(b->data ? b->data + b->len : NULL, room, fmt, ap);
+        va_end(ap);
+        if (n < 0) return;
+        if ((size_t)n < room) { b->len += (size_t)n; break; }
+        size_t cap = b->cap ? b->cap * 2 : 4096;
+        while (cap - b->len <= (size_t)n) cap *= 2;
+        if (!mem_charge(b->mem, cap - b->cap)) { b->full = 1; return; }
+        b->cap = cap;
+        b->data = (char*)realloc(b->data, b->cap);
+        if (!b->data) { perror("realloc"); exit(1); }
+    }
+    if (b->file && b->len >= OUTBUF_FLUSH) out_flush(b);
+}
+
+/* ---- printing rotated vertical tree to tree.txt (like doctor style) ---- */
+void printTreeVertical(OutBuf *out, NodeId root, int space) {
+    if (!root) return;
+    /* nodes added by -O print as the expression they stand for */
+    while (AST_KIND(root) == N_HOISTED || AST_KIND(root) == N_CONST) root = AST_LHS(root);
+
+    if(AST_KIND(root) == N_STMTLIST)
     {
-        printTreeVertical(root->left, space);
-        printTreeVertical(root->right, space);
+        printTreeVertical(out, AST_LHS(root), space);
+        printTreeVertical(out, AST_RHS(root), space);
         return;
     }
 
     int spacing_per_level = 5;
     space += spacing_per_level;
 
-    printTreeVertical(root->right, space);
+    printTreeVertical(out, AST_RHS(root), space);
 
-    fprintf(yytree, "\n");
-    for (int i = spacing_per_level; i < space; i++)
-        fprintf(yytree, " ");
-    fprintf(yytree, "%s\n", root->label);
+    char label[64];
+    out_printf(out, "\n%*s%s\n", space - spacing_per_level, "", node_label(root, label, sizeof label));
 
-    printTreeVertical(root->left, space);
+    printTreeVertical(out, AST_LHS(root), space);
 }
 
 /* print top-level separation */
-void print_tree_header(Node *n) {
+void print_tree_header(OutBuf *out, NodeId n) {
     if (!n) return;
 
-    if(n->kind == N_STMTLIST)
+    if(AST_KIND(n) == N_STMTLIST)
     {
-        print_tree_header(n->left);
-        print_tree_header(n->right);
+        print_tree_header(out, AST_LHS(n));
+        print_tree_header(out, AST_RHS(n));
         return;
     }
 
-    printTreeVertical(n, 0);
-    fprintf(yytree, "\n--------------------------------------------------\n\n");
+    printTreeVertical(out, n, 0);
+    out_printf(out, "\n--------------------------------------------------\n\n");
 }
 
-/* ---- evaluation of expressions at execution time ---- */
-int eval_expr(Node *n) {
-    if (!n) return 0;
-    switch (n->kind) {
-        case N_INT:
-            return n->int_value;
-        case N_VAR:
-            if(!declared[n->var_id]) {
-                semantic_error("Use of undeclared variable", n->line);
-                runtime_error = 1;
-                return 0;
-            }
-            return sym[n->var_id];
-        case N_OP: {
-            int L = eval_expr(n->left);
-            int R = eval_expr(n->right);
-            /* arithmetic */
-            if (strcmp(n->label, "+") == 0) return L + R;
-            if (strcmp(n->label, "-") == 0) return L - R;
-            if (strcmp(n->label, "*") == 0) return L * R;
-            if (strcmp(n->label, "/") == 0) {
-                if (R == 0) { yyerror("Division by zero"); runtime_error = 1; return 0; }
-                return L / R;
-            }
-            /* comparisons -> return 0/1 */
-            if (strcmp(n->label, "==") == 0) return (L == R);
-            if (strcmp(n->label, "!=") == 0) return (L != R);
-            if (strcmp(n->label, "<=") == 0) return (L <= R);
-            if (strcmp(n->label, ">=") == 0) return (L >= R);
-            if (strcmp(n->label, "<") == 0) return (L < R);
-            if (strcmp(n->label, ">") == 0) return (L > R);
-            /* unknown op */
-            yyerror("Unknown operator in eval_expr");
-            return 0;
-        }
-        default:
-            yyerror("eval_expr: expected expression node");
-            return 0;
+/* ---- structured tree dumps (-dump-tree) ----
+   tree.txt is written while the program runs, statement by statement, in
+   a layout meant for reading. tree_dump() writes the whole parsed program
+   instead, without running it, in a form tools can read:
+     json  [stmt, ...], each node {"k":kind, "v":value, "c":[children]}; the
+           blocks of an if or while are arrays among its children
+     dot   a Graphviz digraph; expressions shared by hash-consing are one
+           node with several parents
+     bin   preorder: magic, version, then a list (varint count, items);
+           a node is its kind byte, then a zigzag varint value (int, var) or
+           an operator byte (op), then its children; the blocks of an if or
+           while are lists. An expression written before is the byte 0 and
+           the varint preorder number of its first copy.
+   It is one loop over an explicit stack (statement lists are as deep as
+   they are long), with the format switched at each step. */
+enum { TREE_JSON, TREE_DOT, TREE_BIN };
+enum { DUMP_NODE, DUMP_LIST, DUMP_END };
+
+typedef struct DumpItem {
+    NodeId n;           /* node, or head of a statement list */
+    NodeId parent;      /* dot: source of the edge (0: the program) */
+    uint8_t what;       /* DUMP_NODE, DUMP_LIST or DUMP_END (json: n = 1 closes "]", 2 "]}") */
+    uint8_t first;      /* json: first in its array, no comma */
+    const char *edge;   /* dot: edge label */
+} DumpItem;
+
+static const char *dump_kinds[] = {
+    "", "int", "var", "op", "dec", "assign", "print", "if", "branches", "list",
+    "index", "map", "mapset", "delete", "while"
+};
+
+static void put_varint(FILE *f, uint64_t v) {
+    while (v >= 0x80) {
+        putc((int)(v & 0x7f) | 0x80, f);
+        v >>= 7;
     }
+    putc((int)v, f);
 }
 
-/* Forward declarations */
-void execute_stmt(Node *stmt);
-void execute_list(Node *list);
+int tree_format(const char *name) {
+    if (strcmp(name, "json") == 0) return TREE_JSON;
+    if (strcmp(name, "dot") == 0) return TREE_DOT;
+    if (strcmp(name, "bin") == 0) return TREE_BIN;
+    return -1;
+}
 
-/* execute a single statement node */
-void execute_stmt(Node *stmt) {
-    if (!stmt) return;
-    
+void tree_dump(FILE *f, NodeId root, int format) {
+    DumpItem *stack;
+    size_t depth = 0, cap = 256;
+    uint32_t *seen = (uint32_t*)calloc(ast_count, sizeof(uint32_t));  /* preorder number + 1 */
+    uint32_t order = 0;
 
-    /* Print the statement tree to tree.txt before executing (so tree.txt reflects executed statements) */
-    print_tree_header(stmt);
+    stack = (DumpItem*)malloc(cap * sizeof(DumpItem));
+    if (!stack || !seen) { perror("malloc"); exit(1); }
+    if (format == TREE_DOT) fprintf(f, "digraph program {\n  node [shape=box];\n  n0 [label=\"program\"];\n");
+    if (format == TREE_BIN) fwrite("CTRE\1", 1, 5, f);
+    stack[depth++] = (DumpItem){ root, 0, DUMP_LIST, 1, NULL };
+    while (depth) {
+        DumpItem it = stack[--depth];
+        NodeId n = it.n, slot[3] = { 0, 0, 0 };
+        uint8_t list[3] = { 0, 0, 0 };
+        const char *edge[3] = { NULL, NULL, NULL };
+        int nslots = 0, kind;
 
-    switch (stmt->kind) {
-        case N_DECL: {
-            /* left is var node, right is expression node */
-            runtime_error = 0;
-            int val = eval_expr(stmt->right);
-            if (runtime_error) return;
-            Node *varNode = stmt->left;
-            Node *exprNode = stmt->right;
-            if (varNode->kind == N_VAR) {
-                int id = varNode->var_id;
-                declared[id] = 1; /* mark as declared */
-                sym[id] = val;
-                fprintf(yyout, "STORE var[%d] = %d\n", id, val);
-            } else {
-                yyerror("Declaration left side is not a variable");
-            }
-            break;
+        if (depth + 8 > cap) {
+            stack = (DumpItem*)realloc(stack, (cap *= 2) * sizeof(DumpItem));
+            if (!stack) { perror("realloc"); exit(1); }
         }
-        case N_ASSIGN: {
-            runtime_error = 0;
-            int v = eval_expr(stmt->right);
-            if (runtime_error) return;
-            Node *varNode = stmt->left;
-            Node *exprNode = stmt->right;
-            int val = eval_expr(exprNode);
-            if (varNode->kind == N_VAR) {
-                int id = varNode->var_id;
-                if (!declared[id]) {
-                    semantic_error("Assignment to undeclared variable", varNode->line);
-                    return;
-                }
-                sym[id] = val;
-                fprintf(yyout, "MOV var[%d] = %d\n", id, val);
-            } else {
-                yyerror("Assignment left side is not a variable");
+        if (it.what == DUMP_END) {
+            fputs(n == 2 ? "]}" : "]", f);
+            continue;
+        }
+        if (it.what == DUMP_LIST) {
+            uint32_t count = 0;
+            for (NodeId l = n; l; l = AST_LHS(l)) count++;
+            if (format == TREE_JSON) {
+                fputs(it.first ? "[" : ",[", f);
+                stack[depth++] = (DumpItem){ 1, 0, DUMP_END, 0, NULL };
+            } else if (format == TREE_BIN) {
+                put_varint(f, count);
             }
-            break;
+            if (depth + count > cap) {
+                while (depth + count > cap) cap *= 2;
+                stack = (DumpItem*)realloc(stack, cap * sizeof(DumpItem));
+                if (!stack) { perror("realloc"); exit(1); }
+            }
+            /* the chain runs from the last statement back to the first,
+               which ends up on top */
+            for (NodeId l = n; l; l = AST_LHS(l))
+                stack[depth++] = (DumpItem){ AST_RHS(l), it.parent, DUMP_NODE, AST_LHS(l) == 0, it.edge };
+            continue;
         }
-        case N_PRINT: {
-            runtime_error = 0;
-            int v = eval_expr(stmt->left);
-            if (runtime_error) return;
-            Node *exprNode = stmt->left;
-            int val = eval_expr(exprNode);
-            fprintf(yyout, "Print: %d\n", val);
-            break;
+
+        /* nodes added by -O stand for the expression they hold */
+        while (AST_KIND(n) == N_HOISTED || AST_KIND(n) == N_CONST) n = AST_LHS(n);
+        kind = stmt_kind(n);
+        switch (kind) {
+            case N_INT: case N_VAR:
+                break;
+            case N_PRINT: case N_MAPDECL: case N_MAPDEL:
+                slot[nslots++] = AST_LHS(n);
+                break;
+            case N_IF:
+                slot[nslots++] = AST_LHS(n);
+                slot[nslots] = AST_LHS(AST_RHS(n)); list[nslots] = 1; edge[nslots++] = "then";
+                slot[nslots] = AST_RHS(AST_RHS(n)); list[nslots] = 1; edge[nslots++] = "else";
+                break;
+            case N_WHILE:
+                slot[nslots++] = AST_LHS(n);
+                slot[nslots] = AST_RHS(n); list[nslots] = 1; edge[nslots++] = "body";
+                break;
+            default:    /* op, index, dec, assign, mapset */
+                slot[nslots++] = AST_LHS(n);
+                slot[nslots++] = AST_RHS(n);
+                break;
         }
-        case N_IF: {
-            runtime_error = 0;
-            int v = eval_expr(stmt->left);
-            if (runtime_error) return;
-            Node *cond = stmt->left;
-            Node *branches = stmt->right; /* branches node: left=thenList, right=elseList */
-            int cond_val = eval_expr(cond);
-            if (branches && branches->kind == N_BRANCHES) {
-                Node *thenList = branches->left;
-                Node *elseList = branches->right;
-                if (cond_val) {
-                    execute_list(thenList);
-                } else {
-                    execute_list(elseList);
-                }
-            } else {
-                yyerror("If branches malformed");
+
+        if (format == TREE_JSON) {
+            if (!it.first) putc(',', f);
+            fprintf(f, "{\"k\":\"%s\"", dump_kinds[kind]);
+            if (kind == N_INT) fprintf(f, ",\"v\":%d", AST_VALUE(n));
+            else if (kind == N_VAR) fprintf(f, ",\"v\":%d,\"name\":\"%s\"", AST_VALUE(n), variable_name(AST_VALUE(n)));
+            else if (kind == N_OP) fprintf(f, ",\"op\":\"%s\"", op_names[AST_OP(n)]);
+            if (!nslots) {
+                putc('}', f);
+                continue;
             }
-            break;
-        }
-        case N_STMTLIST: {
-            /* If accidentally a stmtlist passed directly, execute it */
-            execute_list(stmt);
-            break;
+            fputs(",\"c\":[", f);
+            stack[depth++] = (DumpItem){ 2, 0, DUMP_END, 0, NULL };
+        } else if (format == TREE_DOT) {
+            fprintf(f, "  n%u -> n%u", it.parent, n);
+            if (it.edge) fprintf(f, " [label=\"%s\"]", it.edge);
+            fputs(";\n", f);
+            if (seen[n]) continue;
+            seen[n] = 1;
+            if (kind == N_INT) fprintf(f, "  n%u [label=\"%d\"];\n", n, AST_VALUE(n));
+            else if (kind == N_VAR) fprintf(f, "  n%u [label=\"%s\"];\n", n, variable_name(AST_VALUE(n)));
+            else if (kind == N_OP) fprintf(f, "  n%u [label=\"%s\"];\n", n, op_names[AST_OP(n)]);
+            else fprintf(f, "  n%u [label=\"%s\"];\n", n, dump_kinds[kind]);
+        } else {
+            int shared = kind == N_INT || kind == N_VAR || kind == N_OP || kind == N_INDEX;
+            if (shared && seen[n]) {
+                putc(0, f);
+                put_varint(f, seen[n] - 1);
+                continue;
+            }
+            if (shared) seen[n] = order + 1;
+            order++;
+            putc(kind, f);
+            if (kind == N_INT || kind == N_VAR)
+                put_varint(f, ((uint64_t)(int64_t)AST_VALUE(n) << 1) ^ (uint64_t)(int64_t)(AST_VALUE(n) >> 31));
+            else if (kind == N_OP)
+                putc(AST_OP(n), f);
         }
-        default:
-            yyerror("Unknown statement kind in execute_stmt");
-            break;
+        for (int k = nslots - 1; k >= 0; k--)
+            stack[depth++] = (DumpItem){ slot[k], n, list[k] ? DUMP_LIST : DUMP_NODE, k == 0, edge[k] };
     }
+    if (format == TREE_JSON) putc('\n', f);
+    if (format == TREE_DOT) fputs("}\n", f);
+    free(stack);
+    free(seen);
 }
 
-/* execute a list-of-statements node (stmtlist) */
-void execute_list(Node *list) {
-    if (!list) return;
-    if (list->kind == N_STMTLIST) {
-        /* left may be previous list (or NULL), right is a statement */
-        execute_list(list->left);
-        execute_stmt(list->right);
-    } else {
-        /* single statement */
-        execute_stmt(list);
-    }
+/* ---- optimizer (-O) ----
+   optimize_program() rewrites a parsed program before it runs. The
+   rewritten program writes the same out.txt and tree.txt; it only runs
+   fewer statements, which -max-steps counts.
+
+   If/else chains that test one variable against constants,
+       if (x == 1): A else: if (x == 2): B else: ... end end
+   become one N_SWITCH statement. It reads x once and finds the branch in
+   a jump table indexed by x - min when the constants are dense (they span
+   at most twice as many values as there are cases), or by binary search
+   in the sorted constants, instead of testing the cases one by one. The
+   nested ifs a chain would have run still print their trees: the text of
+   each is rendered the first time it is needed and copied after that.
+
+   With -profile-use FILE the passes follow the counts of an earlier run
+   (saved by -profile): code that did not run is left as written, a
+   binary search first tests the constant that took most of the runs, and
+   loops are unrolled by as many passes as they made per entry (see
+   loop_unroll). */
+#define SWITCH_MIN_CASES 4
+
+/* -profile-use: the counters of a -profile run of this program, indexed
+   by NodeId as Exec.cov is (NULL: no profile) */
+uint32_t *profile = NULL;
+NodeId profile_nodes = 0;
+
+/* count of slot n in the profile; -1 without one (or for a node made by
+   the optimizer) */
+static int64_t profile_count(NodeId n) {
+    return profile && n < profile_nodes ? (int64_t)profile[n] : -1;
 }
 
-void semantic_error(const char *msg, int line)
-{
-    fprintf(yyError, "Error: %s at line %d\n", msg, line);
+/* the profile says the if never ran */
+static int profile_cold_if(NodeId stmt) {
+    return profile_count(stmt) == 0 && profile_count(AST_RHS(stmt)) == 0;
 }
 
-%}
+typedef struct Switch {
+    NodeId var;             /* the N_VAR tested */
+    NodeId *ifs;            /* the if of each case, in chain order */
+    uint32_t ncases;
+    int32_t min;
+    uint32_t range;         /* dense: jump[x - min] is the case + 1, 0 for none */
+    uint32_t *jump;
+    int32_t *values;        /* sparse: the distinct constants, sorted, */
+    uint32_t *cases;        /* and the first case testing each */
+    uint32_t nvalues;
+    uint32_t hot;           /* sparse: case + 1 of hot_value, tested before the search (0: none) */
+    int32_t hot_value;
+    char *_Atomic *text;    /* tree text of each case's if, NULL until rendered */
+    _Atomic size_t *text_len;
+} Switch;
 
-/* Bison declarations */
-%union {
-    int ival;
-    float fval;
-    char* sval;
-    struct Node* node;
+Switch *switch_table = NULL;
+size_t switch_count = 0, switch_cap = 0;
+
+/* case of the chain that x selects, or ncases when none does */
+static uint32_t switch_case(const Switch *sw, int x) {
+    if (sw->jump) {
+        uint32_t i = (uint32_t)((int64_t)x - sw->min);
+        if ((int64_t)x < sw->min || i >= sw->range || !sw->jump[i]) return sw->ncases;
+        return sw->jump[i] - 1;
+    }
+    if (sw->hot && x == sw->hot_value) return sw->hot - 1;
+    uint32_t lo = 0, hi = sw->nvalues;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (sw->values[mid] < x) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < sw->nvalues && sw->values[lo] == x ? sw->cases[lo] : sw->ncases;
 }
 
-/* tokens */
-%token<ival> INTEGER
-%token<ival> VARIABLE
-%token PRINT
-%token IF
-%token ELSE
-%token INT
-%token END
-%token<sval> OP
+/* write the tree of case k's if, as running it would. The first program
+   to need it renders it and keeps a copy (charged to that program, and
+   not kept when the charge is refused); programs racing to render the
+   same one keep the first copy. */
+static void switch_tree(OutBuf *tree, MemLimit *mem, const Switch *sw, uint32_t k) {
+    char *text = atomic_load_explicit(&sw->text[k], memory_order_acquire);
+    if (text) {
+        out_write(tree, text, atomic_load_explicit(&sw->text_len[k], memory_order_relaxed));
+        return;
+    }
+    OutBuf copy = { 0 };
+    print_tree_header(&copy, sw->ifs[k]);
+    out_write(tree, copy.data, copy.len);
+    char *none = NULL;
+    if (!mem_charge_spare(mem, copy.len)) {
+        free(copy.data);
+        return;
+    }
+    atomic_store_explicit(&sw->text_len[k], copy.len, memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&sw->text[k], &none, copy.data,
+                                                 memory_order_acq_rel, memory_order_acquire))
+        free(copy.data);
+}
 
-/* nonterminals that carry Node* */
-%type<node> program stmts stmt declaration assignment printStatement IfStatement block condition expr
+/* the variable an if of a chain tests against a constant (0 if it does
+   not), and the constant in *value */
+static NodeId chain_test(NodeId stmt, int *value) {
+    if (AST_KIND(stmt) != N_IF) return 0;
+    NodeId cond = AST_LHS(stmt), l, r;
+    if (AST_KIND(cond) != N_OP || AST_OP(cond) != OP_EQ) return 0;
+    l = AST_LHS(cond);
+    r = AST_RHS(cond);
+    if ((AST_KIND(l) == N_INT || AST_KIND(l) == N_CONST) && AST_KIND(r) == N_VAR) { NodeId t = l; l = r; r = t; }
+    if (AST_KIND(l) != N_VAR || (AST_KIND(r) != N_INT && AST_KIND(r) != N_CONST)) return 0;
+    *value = AST_VALUE(r);
+    return l;
+}
 
-/* precedence & dangling-else */
-%nonassoc LOWER_ELSE
-%right '='
-%left '+' '-'
-%left '*' '/'
+/* the if that is the only statement of an else list, or 0 */
+static NodeId chain_next(NodeId stmt) {
+    NodeId branches = AST_RHS(stmt), list = branches ? AST_RHS(branches) : 0;
+    if (!list || AST_KIND(list) != N_STMTLIST || AST_LHS(list)) return 0;
+    return AST_RHS(list);
+}
 
-%%
+static int compare_case(const void *a, const void *b) {
+    const int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
 
-program:
-      stmts
-      {
-          /* execute top-level statements after parsing */
-          execute_list($1);
-      }
-    ;
+/* ifs of the chain starting at stmt (0 if it does not start one) */
+static uint32_t chain_cases(NodeId stmt) {
+    int value;
+    NodeId var = chain_test(stmt, &value), n;
+    uint32_t ncases = 0;
+    if (var)
+        for (n = stmt; n && chain_test(n, &value) == var; n = chain_next(n)) ncases++;
+    return ncases;
+}
 
-/* stmts forms a stmt-list (or NULL) */
-stmts:
-      /* empty */   { $$ = NULL; }
-    | stmts stmt    {
-                        /* append stmt to list: if $1 == NULL return stmt as list node or create list node */
-                        if ($1 == NULL) {
-                            /* treat single stmt as list (we still wrap it into a stmtlist node to be uniform) */
-                            $$ = new_stmtlist_node(NULL, $2);
-                        } else {
-                            $$ = new_stmtlist_node($1, $2);
-                        }
-                    }
-    ;
+/* lower the chain starting at stmt to an N_SWITCH; returns its number of
+   cases, 0 when it is too short or too large */
+static uint32_t lower_chain(NodeId stmt) {
+    int value;
+    NodeId var = chain_test(stmt, &value), n;
+    uint32_t ncases = chain_cases(stmt);
+    if (ncases < SWITCH_MIN_CASES) return 0;
 
-/* a statement returns a Node* (no execution here) */
-stmt:
-      declaration  { $$ = $1; }
-    | assignment   { $$ = $1; }
-    | printStatement { $$ = $1; }
-    | IfStatement  { $$ = $1; }
-    | expr ';'     { /* expression statement: evaluate at execution time; wrap as a print of value? we keep it as an expr node to be executed as printing its value */
-                      /* We'll wrap it in a print-like node to keep execution consistent: a "printexpr" -> we'll use N_PRINT with left = expr */
-                      $$ = new_print_node($1);
-                    }
-    ;
+    Switch sw = { 0 };
+    sw.var = var;
+    sw.ncases = ncases;
+    sw.ifs = (NodeId*)malloc(ncases * sizeof(NodeId));
+    sw.text = (char *_Atomic *)calloc(ncases, sizeof(char*));
+    sw.text_len = (_Atomic size_t*)calloc(ncases, sizeof(size_t));
+    /* (constant, case) pairs sorted by constant, then by case */
+    int64_t *keys = (int64_t*)malloc(ncases * sizeof(int64_t));
+    if (!sw.ifs || !sw.text || !sw.text_len || !keys) { perror("malloc"); exit(1); }
+    n = stmt;
+    for (uint32_t k = 0; k < ncases; k++, n = chain_next(n)) {
+        sw.ifs[k] = n;
+        chain_test(n, &value);
+        keys[k] = (int64_t)value * ((int64_t)1 << 32) + k;
+    }
+    qsort(keys, ncases, sizeof(int64_t), compare_case);
 
-/* declaration: INT VARIABLE '=' expr ';' */
-declaration:
-      INT VARIABLE '=' expr ';'
-      {
-          /* var node with id */
-          Node *varNode = new_var_node($2);
-          Node *dec = new_decl_node(varNode, $4);
-          $$ = dec;
-      }
-    ;
+    /* a constant tested again further down the chain keeps its first case */
+    sw.values = (int32_t*)malloc(ncases * sizeof(int32_t));
+    sw.cases = (uint32_t*)malloc(ncases * sizeof(uint32_t));
+    if (!sw.values || !sw.cases) { perror("malloc"); exit(1); }
+    for (uint32_t k = 0; k < ncases; k++) {
+        int32_t v = (int32_t)(keys[k] >> 32);
+        if (sw.nvalues && sw.values[sw.nvalues - 1] == v) continue;
+        sw.values[sw.nvalues] = v;
+        sw.cases[sw.nvalues++] = (uint32_t)(keys[k] & 0xffffffffu);
+    }
+    free(keys);
+    int64_t span = (int64_t)sw.values[sw.nvalues - 1] - sw.values[0] + 1;
+    if (span <= 2 * (int64_t)sw.nvalues) {
+        sw.min = sw.values[0];
+        sw.range = (uint32_t)span;
+        sw.jump = (uint32_t*)calloc(sw.range, sizeof(uint32_t));
+        if (!sw.jump) { perror("calloc"); exit(1); }
+        for (uint32_t i = 0; i < sw.nvalues; i++)
+            sw.jump[sw.values[i] - sw.min] = sw.cases[i] + 1;
+        free(sw.values);
+        free(sw.cases);
+        sw.values = NULL;
+        sw.cases = NULL;
+    } else if (profile_count(stmt) > 0) {
+        /* a constant that took more than half of the runs */
+        int64_t runs = profile_count(stmt) + profile_count(AST_RHS(stmt)), best = 0;
+        for (uint32_t i = 0; i < sw.nvalues; i++) {
+            int64_t c = profile_count(sw.ifs[sw.cases[i]]);
+            if (c > best) {
+                best = c;
+                sw.hot = sw.cases[i] + 1;
+                sw.hot_value = sw.values[i];
+            }
+        }
+        if (2 * best <= runs) sw.hot = 0;
+    }
 
-/* assignment: VARIABLE '=' expr ';' */
-assignment:
-      VARIABLE '=' expr ';'
-      {
-          Node *varNode = new_var_node($1);
-          Node *asn = new_assign_node(varNode, $3);
-          $$ = asn;
-      }
-    ;
+    if (switch_count == switch_cap) {
+        switch_cap = switch_cap ? switch_cap * 2 : 16;
+        switch_table = (Switch*)realloc(switch_table, switch_cap * sizeof(Switch));
+        if (!switch_table) { perror("realloc"); exit(1); }
+    }
+    switch_table[switch_count] = sw;
+    AST_KIND(stmt) = N_SWITCH;
+    AST_VALUE(stmt) = (int)switch_count++;
+    return ncases;
+}
 
-/* printStatement: PRINT '(' expr ')' ';' */
-printStatement:
-      PRINT '(' expr ')' ';'
-      {
-          Node *p = new_print_node($3);
-          $$ = p;
-      }
-    ;
+/* -opt-report: the notes are collected while the passes walk the
+   program (statement lists run backwards) and written in line order */
+typedef struct OptNote {
+    int line;
+    uint32_t seq;
+    char *text;
+} OptNote;
+
+static FILE *opt_report = NULL;     /* -opt-report file (NULL: none) */
+static OptNote *opt_notes = NULL;
+static size_t opt_note_count = 0, opt_note_cap = 0;
+
+static void opt_note(NodeId stmt, const char *fmt, ...) {
+    if (!opt_report) return;
+    char text[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(text, sizeof text, fmt, ap);
+    va_end(ap);
+    if (opt_note_count == opt_note_cap) {
+        opt_note_cap = opt_note_cap ? opt_note_cap * 2 : 16;
+        opt_notes = (OptNote*)realloc(opt_notes, opt_note_cap * sizeof(OptNote));
+        if (!opt_notes) { perror("realloc"); exit(1); }
+    }
+    OptNote *n = &opt_notes[opt_note_count];
+    n->line = stmt_line(stmt);
+    n->seq = (uint32_t)opt_note_count++;
+    n->text = strdup(text);
+    if (!n->text) { perror("strdup"); exit(1); }
+}
+
+static int compare_note(const void *a, const void *b) {
+    const OptNote *x = (const OptNote*)a, *y = (const OptNote*)b;
+    if (x->line != y->line) return (x->line > y->line) - (x->line < y->line);
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+static void opt_notes_write(void) {
+    qsort(opt_notes, opt_note_count, sizeof(OptNote), compare_note);
+    for (size_t i = 0; i < opt_note_count; i++) {
+        fprintf(opt_report, "line %d: %s\n", opt_notes[i].line, opt_notes[i].text);
+        free(opt_notes[i].text);
+    }
+    free(opt_notes);
+    opt_notes = NULL;
+    opt_note_count = opt_note_cap = 0;
+}
+
+static void lower_chains(NodeId list);
+
+static void lower_chains_stmt(NodeId stmt) {
+    if (AST_KIND(stmt) == N_WHILE) {
+        lower_chains(AST_RHS(stmt));
+        return;
+    }
+    if (AST_KIND(stmt) != N_IF) return;
+    if (profile_cold_if(stmt)) {
+        if (chain_cases(stmt) >= SWITCH_MIN_CASES) opt_note(stmt, "if chain: did not run in the profile, not lowered");
+        return;
+    }
+    uint32_t ncases = lower_chain(stmt);
+    if (!ncases) {
+        NodeId branches = AST_RHS(stmt);
+        lower_chains(AST_LHS(branches));
+        lower_chains(AST_RHS(branches));
+        return;
+    }
+    /* the nested ifs of the chain are only reached through the switch
+       (switch_table moves as the branches add their own) */
+    const Switch *sw = &switch_table[AST_VALUE(stmt)];
+    NodeId *ifs = sw->ifs;
+    if (sw->hot)
+        opt_note(stmt, "if chain on %s: %u cases, binary search after testing %d (hot in the profile)",
+                 variable_name(AST_VALUE(sw->var)), ncases, sw->hot_value);
+    else
+        opt_note(stmt, "if chain on %s: %u cases, %s", variable_name(AST_VALUE(sw->var)),
+                 ncases, sw->jump ? "jump table" : "binary search");
+    for (uint32_t k = 0; k < ncases; k++)
+        lower_chains(AST_LHS(AST_RHS(ifs[k])));
+    lower_chains(AST_RHS(AST_RHS(ifs[ncases - 1])));
+}
+
+static void lower_chains(NodeId list) {
+    /* lists are linked through their left child: walk them without recursing */
+    for (; list && AST_KIND(list) == N_STMTLIST; list = AST_LHS(list))
+        lower_chains_stmt(AST_RHS(list));
+}
+
+static void switch_free(void) {
+    for (size_t i = 0; i < switch_count; i++) {
+        Switch *sw = &switch_table[i];
+        free(sw->ifs);
+        free(sw->jump);
+        free(sw->values);
+        free(sw->cases);
+        for (uint32_t k = 0; k < sw->ncases; k++) free(sw->text[k]);
+        free((void*)sw->text);
+        free((void*)sw->text_len);
+    }
+    free(switch_table);
+    switch_table = NULL;
+    switch_count = switch_cap = 0;
+}
+
+/* ---- variable storage ----
+   The symbol table (variables are represented by integer IDs provided by
+   scanner) is split into pages of VAR_PAGE_SIZE variables. A page is
+   shared copy-on-write: exec_fork() gives the child the parent's pages,
+   and whichever program first writes to a shared page gets its own copy.
+   A missing page holds only undeclared variables. */
+#define VAR_PAGE_BITS 5
+#define VAR_PAGE_SIZE (1 << VAR_PAGE_BITS)
+#define VAR_PAGE_MASK (VAR_PAGE_SIZE - 1)
+#define MAX_VARS 256
+#define VAR_PAGES (MAX_VARS / VAR_PAGE_SIZE)
+
+#define VAR_INT 1   /* declared[] of an int variable */
+#define VAR_MAP 2   /* declared[] of a map variable; sym[] is its index in Exec.maps */
+
+typedef struct VarPage {
+    _Atomic int refs;           /* programs sharing this page */
+    int sym[VAR_PAGE_SIZE];
+    uint8_t declared[VAR_PAGE_SIZE];    /* track declared variables: 0, VAR_INT or VAR_MAP */
+} VarPage;
+
+static void var_page_release(VarPage *p) {
+    if (p && atomic_fetch_sub_explicit(&p->refs, 1, memory_order_acq_rel) == 1)
+        free(p);
+}
+
+/* ---- maps ----
+   A variable declared with `map m;` holds int keys and values. Its slot in
+   the symbol table is marked VAR_MAP and its value is an index into the
+   program's Exec.maps. The table is a Swiss table: open addressing over
+   groups of MAP_GROUP slots, with one control byte per slot that is
+   MAP_EMPTY, MAP_DELETED or the low 7 bits of the key's hash (h2). A probe
+   starts at the group chosen by the rest of the hash (h1) and compares h2
+   against all control bytes of the group with one SIMD compare, so keys
+   are only compared in slots whose h2 matches; a group with an empty slot
+   ends the probe. Groups are visited in triangular order, which reaches
+   every group of a power-of-two table. At most 7/8 of the slots are ever
+   in use, counting tombstones, so a probe always ends. Tables are shared
+   copy-on-write between forks, like variable pages. */
+#define MAP_GROUP 16
+#define MAP_EMPTY ((int8_t)-128)
+#define MAP_DELETED ((int8_t)-2)
+
+typedef struct IntMap {
+    _Atomic int refs;           /* programs sharing this map */
+    int8_t *ctrl;               /* cap control bytes, then the keys and values */
+    int32_t *keys, *vals;
+    uint32_t cap;               /* slots: 0 or a power of two >= MAP_GROUP */
+    uint32_t size;              /* keys present */
+    uint32_t growth_left;       /* empty slots that may still be filled before a rehash */
+} IntMap;
+
+/* bit i set when control byte i of the group equals h */
+static uint32_t map_match(const int8_t *group, int8_t h) {
+#if defined(__SSE2__)
+    __m128i c = _mm_load_si128((const __m128i*)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8(h)));
+#else
+    uint32_t bits = 0;
+    for (int i = 0; i < MAP_GROUP; i++)
+        if (group[i] == h) bits |= 1u << i;
+    return bits;
+#endif
+}
+
+/* bit i set when slot i of the group is empty or deleted (sign bit set) */
+static uint32_t map_match_free(const int8_t *group) {
+#if defined(__SSE2__)
+    return (uint32_t)_mm_movemask_epi8(_mm_load_si128((const __m128i*)group));
+#else
+    uint32_t bits = 0;
+    for (int i = 0; i < MAP_GROUP; i++)
+        if (group[i] < 0) bits |= 1u << i;
+    return bits;
+#endif
+}
+
+static uint64_t map_hash(int32_t key) {
+    uint64_t h = (uint32_t)key * 0x9e3779b97f4a7c15ull;
+    return h ^ (h >> 32);
+}
+
+IntMap *map_new(void) {
+    IntMap *m = (IntMap*)calloc(1, sizeof(IntMap));
+    if (!m) { perror("calloc"); exit(1); }
+    atomic_init(&m->refs, 1);
+    return m;
+}
+
+void map_release(IntMap *m) {
+    if (m && atomic_fetch_sub_explicit(&m->refs, 1, memory_order_acq_rel) == 1) {
+        free_aligned(m->ctrl);
+        free(m);
+    }
+}
+
+/* slot holding key, or -1 */
+static int64_t map_slot(const IntMap *m, int32_t key) {
+    if (!m->cap) return -1;
+    uint64_t h = map_hash(key);
+    uint32_t mask = m->cap / MAP_GROUP - 1, g = (uint32_t)(h >> 7) & mask;
+    int8_t h2 = (int8_t)(h & 0x7f);
+    for (uint32_t step = 1;; step++) {
+        const int8_t *group = m->ctrl + (size_t)g * MAP_GROUP;
+        for (uint32_t bits = map_match(group, h2); bits; bits &= bits - 1) {
+            uint32_t i = g * MAP_GROUP + (uint32_t)__builtin_ctz(bits);
+            if (m->keys[i] == key) return i;
+        }
+        if (map_match(group, MAP_EMPTY)) return -1;
+        g = (g + step) & mask;
+    }
+}
+
+/* first empty or deleted slot on key's probe sequence */
+static uint32_t map_free_slot(const IntMap *m, uint64_t h) {
+    uint32_t mask = m->cap / MAP_GROUP - 1, g = (uint32_t)(h >> 7) & mask;
+    for (uint32_t step = 1;; step++) {
+        uint32_t bits = map_match_free(m->ctrl + (size_t)g * MAP_GROUP);
+        if (bits) return g * MAP_GROUP + (uint32_t)__builtin_ctz(bits);
+        g = (g + step) & mask;
+    }
+}
+
+/* move the entries into a table of cap slots, dropping the tombstones;
+   0 if the memory limit refuses it */
+static int map_rehash(IntMap *m, uint32_t cap, MemLimit *mem) {
+    size_t bytes = (size_t)cap * (1 + 2 * sizeof(int32_t));
+    if (!mem_charge(mem, bytes)) return 0;
+    int8_t *ctrl = (int8_t*)alloc_aligned(MAP_GROUP, bytes);
+    if (!ctrl) { perror("aligned_alloc"); exit(1); }
+    IntMap old = *m;
+    memset(ctrl, MAP_EMPTY, cap);
+    m->ctrl = ctrl;
+    m->keys = (int32_t*)(ctrl + cap);
+    m->vals = m->keys + cap;
+    m->cap = cap;
+    m->growth_left = cap - cap / 8 - m->size;
+    for (uint32_t i = 0; i < old.cap; i++) {
+        if (old.ctrl[i] < 0) continue;
+        uint32_t j = map_free_slot(m, map_hash(old.keys[i]));
+        m->ctrl[j] = old.ctrl[i];
+        m->keys[j] = old.keys[i];
+        m->vals[j] = old.vals[i];
+    }
+    free_aligned(old.ctrl);
+    return 1;
+}
+
+/* a private copy of m, for a program about to change a shared map */
+static IntMap *map_clone(const IntMap *m, MemLimit *mem) {
+    IntMap *c = map_new();
+    if (m->cap && !map_rehash(c, m->cap, mem)) { map_release(c); return NULL; }
+    for (uint32_t i = 0; i < m->cap; i++) {
+        if (m->ctrl[i] < 0) continue;
+        uint32_t j = map_free_slot(c, map_hash(m->keys[i]));
+        c->ctrl[j] = m->ctrl[i];
+        c->keys[j] = m->keys[i];
+        c->vals[j] = m->vals[i];
+        c->size++;
+        c->growth_left--;
+    }
+    return c;
+}
+
+int map_get(const IntMap *m, int32_t key, int *value) {
+    int64_t i = map_slot(m, key);
+    if (i < 0) return 0;
+    *value = m->vals[i];
+    return 1;
+}
+
+/* insert or replace; 0 if the table could not grow */
+int map_put(IntMap *m, int32_t key, int value, MemLimit *mem) {
+    int64_t i = map_slot(m, key);
+    if (i >= 0) { m->vals[i] = value; return 1; }
+    if (m->growth_left == 0) {
+        /* grow when live keys fill over half the usable slots, else just
+           drop the tombstones */
+        uint32_t cap = m->cap ? m->cap : MAP_GROUP;
+        while ((uint64_t)(m->size + 1) * 16 > (uint64_t)cap * 7) cap *= 2;
+        if (!map_rehash(m, cap, mem)) return 0;
+    }
+    uint64_t h = map_hash(key);
+    uint32_t j = map_free_slot(m, h);
+    if (m->ctrl[j] == MAP_EMPTY) m->growth_left--;
+    m->ctrl[j] = (int8_t)(h & 0x7f);
+    m->keys[j] = key;
+    m->vals[j] = value;
+    m->size++;
+    return 1;
+}
+
+/* remove key; 0 if it was not there */
+int map_del(IntMap *m, int32_t key) {
+    int64_t i = map_slot(m, key);
+    if (i < 0) return 0;
+    /* a group that still has an empty slot never ended a probe that went
+       past it, so the slot can become empty again */
+    const int8_t *group = m->ctrl + (i & ~(int64_t)(MAP_GROUP - 1));
+    if (map_match(group, MAP_EMPTY)) {
+        m->ctrl[i] = MAP_EMPTY;
+        m->growth_left++;
+    } else {
+        m->ctrl[i] = MAP_DELETED;
+    }
+    m->size--;
+    return 1;
+}
+
+/* ---- shared variables ----
+   -shared NAME[:MODE] designates a variable whose value is shared by every
+   program running in the process (-batch, -fork, -pipeline), e.g. a
+   metrics counter. It is declared in every program and lives in this
+   table instead of the program's own pages: the scanner gives it a fixed
+   id from SHARED_BASE up. There is no lock. The value is an atomic int,
+   accessed with sequentially consistent (seq_cst, the default) or relaxed
+   ordering. A sharded counter keeps one relaxed slot per thread on its own
+   cache line; increments touch only the thread's slot, and a read adds
+   the slots up. An assignment of the form x = x + e, x = e + x or
+   x = x - e to a shared variable is a single atomic add, so concurrent
+   increments are never lost. Any other assignment is a plain store (for a
+   sharded counter it is not atomic with concurrent increments). */
+#define CACHE_LINE 64
+#define MAX_SHARED 32
+#define SHARED_BASE (MAX_VARS - MAX_SHARED)
+#define SHARDS 16
+
+enum { SHARED_SEQ_CST, SHARED_RELAXED, SHARED_SHARDED };
+static const char *shared_modes[] = { "seq_cst", "relaxed", "sharded" };
+
+typedef struct Shard {
+    _Atomic int value;
+    char pad[CACHE_LINE - sizeof(int)];
+} Shard;
+
+typedef struct SharedVar {
+    char name[64];
+    int mode;
+    _Atomic int value;          /* seq_cst and relaxed */
+    Shard *shards;              /* sharded: the value is their sum */
+} SharedVar;
+
+SharedVar shared_vars[MAX_SHARED];
+int shared_count = 0;
+
+static _Atomic int shard_next = 0;
+static _Thread_local int shard_index = -1;
+
+/* add a -shared NAME[:MODE] designation; returns 0 if it is malformed */
+int shared_define(const char *spec) {
+    const char *colon = strchr(spec, ':');
+    size_t len = colon ? (size_t)(colon - spec) : strlen(spec);
+    int mode = SHARED_SEQ_CST;
+    if (shared_count == MAX_SHARED || len == 0 || len >= sizeof shared_vars[0].name) return 0;
+    if (colon) {
+        for (mode = 0; mode < 3 && strcmp(colon + 1, shared_modes[mode]) != 0; mode++)
+            ;
+        if (mode == 3) return 0;
+    }
+    SharedVar *v = &shared_vars[shared_count++];
+    memcpy(v->name, spec, len);
+    v->name[len] = '\0';
+    v->mode = mode;
+    atomic_init(&v->value, 0);
+    if (mode == SHARED_SHARDED) {
+        v->shards = (Shard*)calloc(SHARDS, sizeof(Shard));
+        if (!v->shards) { perror("calloc"); exit(1); }
+    }
+    return 1;
+}
+
+/* id of a shared variable, or -1 (called by the scanner) */
+int shared_var_id(const char *name) {
+    for (int i = 0; i < shared_count; i++)
+        if (strcmp(shared_vars[i].name, name) == 0) return SHARED_BASE + i;
+    return -1;
+}
+
+static int shared_load(int id) {
+    SharedVar *v = &shared_vars[id - SHARED_BASE];
+    if (v->mode == SHARED_SHARDED) {
+        int sum = 0;
+        for (int i = 0; i < SHARDS; i++)
+            sum += atomic_load_explicit(&v->shards[i].value, memory_order_relaxed);
+        return sum;
+    }
+    return atomic_load_explicit(&v->value, v->mode == SHARED_RELAXED ? memory_order_relaxed : memory_order_seq_cst);
+}
+
+static void shared_store(int id, int value) {
+    SharedVar *v = &shared_vars[id - SHARED_BASE];
+    if (v->mode == SHARED_SHARDED) {
+        for (int i = 0; i < SHARDS; i++)
+            atomic_store_explicit(&v->shards[i].value, i == 0 ? value : 0, memory_order_relaxed);
+        return;
+    }
+    atomic_store_explicit(&v->value, value, v->mode == SHARED_RELAXED ? memory_order_relaxed : memory_order_seq_cst);
+}
+
+/* add delta; returns the new value */
+static int shared_add(int id, int delta) {
+    SharedVar *v = &shared_vars[id - SHARED_BASE];
+    if (v->mode == SHARED_SHARDED) {
+        if (shard_index < 0)
+            shard_index = atomic_fetch_add_explicit(&shard_next, 1, memory_order_relaxed) % SHARDS;
+        atomic_fetch_add_explicit(&v->shards[shard_index].value, delta, memory_order_relaxed);
+        return shared_load(id);
+    }
+    return atomic_fetch_add_explicit(&v->value, delta,
+               v->mode == SHARED_RELAXED ? memory_order_relaxed : memory_order_seq_cst) + delta;
+}
+
+/* final values, printed after -batch / -fork */
+void shared_report(FILE *f) {
+    for (int i = 0; i < shared_count; i++)
+        fprintf(f, "shared %s = %d\n", shared_vars[i].name, shared_load(SHARED_BASE + i));
+}
+
+/* ---- execution state ----
+   Everything a running program owns: its symbol table, its output and the
+   statements it has still to run. Statements are taken from an explicit
+   stack (next statement on top) instead of recursing through the
+   stmt-lists, so execution can stop after any statement and be resumed
+   later: exec_run() runs a slice of a program and -batch interleaves
+   many programs that way. */
+typedef struct Exec {
+    VarPage *vars[VAR_PAGES];
+    int runtime_error;
+    NodeId stmt;            /* statement being executed, located only when reporting an error */
+    OutBuf out, tree;       /* out.txt, tree.txt */
+    NodeId *stack;          /* statements still to run */
+    size_t depth, cap;
+    uint64_t fuel;          /* statements that may run before exec_refuel() */
+    uint64_t budget;        /* rest of the statement budget (UINT64_MAX: none) */
+    double deadline;        /* now_seconds() to stop at (0: none) */
+    int stopped;            /* a limit was hit: nothing more runs */
+    int deadline_hit;       /* the limit was the deadline */
+    int budget_is_deadline; /* -replay: running out of the budget is the recorded deadline */
+    uint64_t issued;        /* fuel handed out so far; issued - fuel statements have run */
+    const char *checkpoint; /* -checkpoint file (NULL: none) */
+    uint64_t checkpoint_every;  /* statements between checkpoints (0: only when stopped by a limit) */
+    uint64_t next_checkpoint;   /* value of issued at which the next one is written */
+    MemLimit *mem;          /* the program's memory limit (NULL: none) */
+    int alloc_failed;       /* the stack or a variable page could not be allocated */
+    int track_vars;         /* record the variables used in reads and writes */
+    int no_tree;            /* produce no tree.txt text (-bench-map times the statements alone) */
+    uint64_t reads[MAX_VARS / 64], writes[MAX_VARS / 64];  /* variables used (-speculate) */
+    uint32_t *cov;          /* -coverage/-profile counters, indexed by NodeId (NULL: off) */
+    IntMap **maps;          /* tables of the map variables */
+    uint32_t nmaps, maps_cap;
+    int *hoisted;           /* values of the loop-invariant expressions (-O), */
+    uint8_t *hoisted_set;   /* set once computed since their loop was entered */
+    uint32_t nhoisted;
+} Exec;
+
+/* count one run in a -coverage/-profile counter; counters stick at UINT32_MAX */
+#define COVER(ex, n) do { if ((ex)->cov) (ex)->cov[n] += (ex)->cov[n] != UINT32_MAX; } while (0)
+
+/* only -speculate sets track_vars: other runs skip the bitmaps */
+#define VAR_BIT(ex, set, id) \
+    do { if ((ex)->track_vars) (ex)->set[(id) >> 6] |= (uint64_t)1 << ((id) & 63); } while (0)
+
+/* 0 (undeclared), VAR_INT or VAR_MAP */
+static int var_declared(Exec *ex, int id) {
+    const VarPage *p = ex->vars[id >> VAR_PAGE_BITS];
+    VAR_BIT(ex, reads, id);
+    if (id >= SHARED_BASE) return VAR_INT;
+    return p ? p->declared[id & VAR_PAGE_MASK] : 0;
+}
+
+static int var_value(Exec *ex, int id) {
+    const VarPage *p = ex->vars[id >> VAR_PAGE_BITS];
+    VAR_BIT(ex, reads, id);
+    if (id >= SHARED_BASE) return shared_load(id);
+    return p ? p->sym[id & VAR_PAGE_MASK] : 0;
+}
+
+/* the page holding id, made private to ex first (NULL if over the memory limit) */
+static VarPage *var_page_for_write(Exec *ex, int id) {
+    VarPage **slot = &ex->vars[id >> VAR_PAGE_BITS];
+    VarPage *p = *slot;
+    if (p && atomic_load_explicit(&p->refs, memory_order_acquire) == 1) return p;
+    if (!mem_charge(ex->mem, sizeof(VarPage))) { ex->alloc_failed = 1; return NULL; }
+    VarPage *copy = (VarPage*)malloc(sizeof(VarPage));
+    if (!copy) { perror("malloc"); exit(1); }
+    if (p) memcpy(copy, p, sizeof *copy);
+    else memset(copy, 0, sizeof *copy);
+    atomic_init(&copy->refs, 1);
+    var_page_release(p);
+    *slot = copy;
+    return copy;
+}
+
+static void var_store(Exec *ex, int id, int value, int declare) {
+    if (id >= SHARED_BASE) { shared_store(id, value); return; }
+    VarPage *p = var_page_for_write(ex, id);
+    VAR_BIT(ex, writes, id);
+    if (!p) return;
+    if (declare) p->declared[id & VAR_PAGE_MASK] = (uint8_t)declare;
+    p->sym[id & VAR_PAGE_MASK] = value;
+}
+
+/* the table of map variable id, made private to ex first when for_write
+   (NULL if id is not a map, or over the memory limit) */
+static IntMap *var_map(Exec *ex, int id, int for_write) {
+    if (var_declared(ex, id) != VAR_MAP) return NULL;
+    IntMap **slot = &ex->maps[var_value(ex, id)];
+    if (!for_write) return *slot;
+    VAR_BIT(ex, writes, id);
+    if (atomic_load_explicit(&(*slot)->refs, memory_order_acquire) == 1) return *slot;
+    IntMap *copy = map_clone(*slot, ex->mem);
+    if (!copy) { ex->alloc_failed = 1; return NULL; }
+    map_release(*slot);
+    return *slot = copy;
+}
+
+/* make id a map variable holding m, taking over the caller's reference */
+static void var_set_map(Exec *ex, int id, IntMap *m) {
+    if (var_declared(ex, id) == VAR_MAP) {
+        IntMap **slot = &ex->maps[var_value(ex, id)];
+        map_release(*slot);
+        *slot = m;
+        VAR_BIT(ex, writes, id);
+        return;
+    }
+    if (ex->nmaps == ex->maps_cap) {
+        uint32_t cap = ex->maps_cap ? ex->maps_cap * 2 : 8;
+        if (!mem_charge(ex->mem, (cap - ex->maps_cap) * sizeof(IntMap*))) {
+            ex->alloc_failed = 1;
+            map_release(m);
+            return;
+        }
+        ex->maps_cap = cap;
+        ex->maps = (IntMap**)realloc(ex->maps, cap * sizeof(IntMap*));
+        if (!ex->maps) { perror("realloc"); exit(1); }
+    }
+    ex->maps[ex->nmaps] = m;
+    var_store(ex, id, (int)ex->nmaps++, VAR_MAP);
+}
+
+/* copy variable id of from into to; a map is shared, not copied */
+static void var_copy(Exec *to, Exec *from, int id) {
+    if (var_declared(from, id) == VAR_MAP) {
+        IntMap *m = var_map(from, id, 0);
+        atomic_fetch_add_explicit(&m->refs, 1, memory_order_relaxed);
+        var_set_map(to, id, m);
+    } else {
+        var_store(to, id, var_value(from, id), var_declared(from, id));
+    }
+}
+
+void exec_init(Exec *ex, FILE *out, FILE *tree, MemLimit *mem) {
+    memset(ex, 0, sizeof *ex);
+    ex->out.file = out;
+    ex->tree.file = tree;
+    ex->out.mem = ex->tree.mem = ex->mem = mem;
+    ex->budget = UINT64_MAX;
+}
+
+/* limit the program to max_steps statements (0: no limit) and to
+   `seconds` of wall-clock time from now (0: no limit) */
+void exec_set_limits(Exec *ex, uint64_t max_steps, double seconds) {
+    ex->budget = max_steps ? max_steps : UINT64_MAX;
+    ex->deadline = seconds > 0 ? now_seconds() + seconds : 0;
+    ex->fuel = 0;
+}
+
+int exec_checkpoint(Exec *ex, const char *path);
+
+/* save the program to path every `every` statements (0: never) and, instead
+   of failing it, when it is stopped by -max-steps or -deadline */
+void exec_set_checkpoint(Exec *ex, const char *path, uint64_t every) {
+    ex->checkpoint = path;
+    ex->checkpoint_every = path ? every : 0;
+    ex->next_checkpoint = ex->issued + every;
+    ex->fuel = 0;
+}
+
+void exec_free(Exec *ex) {
+    for (int i = 0; i < VAR_PAGES; i++) {
+        var_page_release(ex->vars[i]);
+        ex->vars[i] = NULL;
+    }
+    for (uint32_t i = 0; i < ex->nmaps; i++)
+        map_release(ex->maps[i]);
+    free(ex->maps);
+    ex->maps = NULL;
+    ex->nmaps = ex->maps_cap = 0;
+    free(ex->hoisted);
+    free(ex->hoisted_set);
+    ex->hoisted = NULL;
+    ex->hoisted_set = NULL;
+    ex->nhoisted = 0;
+    free(ex->out.data);
+    free(ex->tree.data);
+    free(ex->stack);
+    ex->out.data = ex->tree.data = NULL;
+    ex->stack = NULL;
+    ex->depth = ex->cap = 0;
+}
+
+static void exec_push(Exec *ex, NodeId stmt) {
+    if (ex->depth == ex->cap) {
+        size_t cap = ex->cap ? ex->cap * 2 : 64;
+        if (!mem_charge(ex->mem, (cap - ex->cap) * sizeof(NodeId))) { ex->alloc_failed = 1; return; }
+        ex->cap = cap;
+        ex->stack = (NodeId*)realloc(ex->stack, ex->cap * sizeof(NodeId));
+        if (!ex->stack) { perror("realloc"); exit(1); }
+    }
+    ex->stack[ex->depth++] = stmt;
+}
+
+/* schedule a list-of-statements node (stmtlist) or a single statement to
+   run next. The list is linked from its last statement (left = previous
+   list, right = stmt), so walking it pushes the last statement first and
+   leaves the first one on top. */
+void exec_push_list(Exec *ex, NodeId list) {
+    while (list && AST_KIND(list) == N_STMTLIST) {
+        if (AST_RHS(list)) exec_push(ex, AST_RHS(list));
+        list = AST_LHS(list);
+    }
+    if (list) exec_push(ex, list);
+}
+
+/* start child as a copy of the running program parent, e.g. to try several
+   continuations of a common prefix (-fork): the variable pages are shared
+   copy-on-write, the pending statements are copied and the child writes
+   its own output */
+void exec_fork(Exec *child, const Exec *parent, FILE *out, FILE *tree, MemLimit *mem) {
+    exec_init(child, out, tree, mem);
+    for (int i = 0; i < VAR_PAGES; i++) {
+        child->vars[i] = parent->vars[i];
+        if (child->vars[i]) atomic_fetch_add_explicit(&child->vars[i]->refs, 1, memory_order_relaxed);
+    }
+    if (parent->nmaps) {
+        child->maps = (IntMap**)malloc(parent->nmaps * sizeof(IntMap*));
+        if (!child->maps) { perror("malloc"); exit(1); }
+        mem_charge(mem, parent->nmaps * sizeof(IntMap*));
+        child->nmaps = child->maps_cap = parent->nmaps;
+        for (uint32_t i = 0; i < parent->nmaps; i++) {
+            child->maps[i] = parent->maps[i];
+            atomic_fetch_add_explicit(&child->maps[i]->refs, 1, memory_order_relaxed);
+        }
+    }
+    for (size_t i = 0; i < parent->depth; i++)
+        exec_push(child, parent->stack[i]);
+}
+
+/* ---- loops (-O) ----
+   After if chains are lowered, the optimizer takes every while loop, outer
+   loops first:
+
+   - Loop-invariant expressions, whose variables the body never writes and
+     which read no shared variable, are hoisted. Each largest one becomes
+     an N_HOISTED node with a slot in Exec.hoisted: its first evaluation
+     after the loop is entered keeps the value and later ones read it, so
+     an expression that fails (dividing by zero, say) still fails where
+     and when it did. Hash-consing makes repeats of an expression share
+     the slot. The statements and expressions above it are copied, and
+     tree.txt prints through the N_HOISTED node, so the trees are unchanged.
+   - A loop whose condition compares a variable with an invariant bound,
+     where a top-level statement of the body (not inside an if) steps the
+     variable by a constant (i = i + 4;) and nothing else writes it, is
+     unrolled: each test of the condition works out how many passes are
+     left and runs up to -unroll of them before testing it again. A loop
+     with no more passes left than that runs them all without another test
+     until the last.
+     With a profile, a loop that made fewer than PROFILE_MIN_PASSES passes
+     per entry is not unrolled, and one that made more than -unroll is
+     unrolled by that many (up to PROFILE_MAX_UNROLL); a loop that never
+     ran is left as written.
+
+   The remaining passes only depend on the variable, the bound and the
+   step, so the statements run are those of the original loop; only the
+   tests between them are skipped. */
+#define UNROLL_DEFAULT 4
+#define PROFILE_MIN_PASSES 2
+#define PROFILE_MAX_UNROLL 32
+
+typedef struct Loop {
+    uint32_t slot, nslots;  /* slots of its hoisted expressions */
+    int var;                /* unrolled: `var op bound`, var += step each pass */
+    int op;
+    NodeId bound;
+    int64_t step;
+    uint32_t unroll;        /* passes per test (1: not unrolled) */
+} Loop;
+
+Loop *loop_table = NULL;
+size_t loop_count = 0, loop_cap = 0;
+uint32_t hoist_count = 0;           /* slots of all loops */
+uint32_t unroll_factor = UNROLL_DEFAULT;
+
+/* while hoisting for one loop: the N_HOISTED node made for an expression
+   (indexed by NodeId, tagged with the loop so that no clearing is needed) */
+typedef struct HoistSeen {
+    uint32_t loop;      /* loop index + 1 */
+    NodeId node;
+} HoistSeen;
+
+static HoistSeen *hoist_seen = NULL;
+static uint32_t hoist_seen_cap = 0;
+
+static void count_writes(NodeId list, uint32_t *writes);
+
+/* count the statements of a body writing each variable */
+static void count_writes_stmt(NodeId stmt, uint32_t *writes) {
+    switch (AST_KIND(stmt)) {
+        case N_DECL: case N_ASSIGN: case N_MAPDECL:
+            writes[AST_VALUE(AST_LHS(stmt))]++;
+            break;
+        case N_MAPSET: case N_MAPDEL:
+            writes[AST_VALUE(AST_LHS(AST_LHS(stmt)))]++;
+            break;
+        case N_IF: case N_SWITCH:
+            /* a lowered chain keeps its nested ifs */
+            count_writes(AST_LHS(AST_RHS(stmt)), writes);
+            count_writes(AST_RHS(AST_RHS(stmt)), writes);
+            break;
+        case N_WHILE:
+            count_writes(AST_RHS(stmt), writes);
+            break;
+    }
+}
+
+static void count_writes(NodeId list, uint32_t *writes) {
+    for (; list && AST_KIND(list) == N_STMTLIST; list = AST_LHS(list))
+        count_writes_stmt(AST_RHS(list), writes);
+}
+
+static int is_const(NodeId e) {
+    return AST_KIND(e) == N_INT || AST_KIND(e) == N_CONST;
+}
+
+static int is_leaf(NodeId e) {
+    return is_const(e) || AST_KIND(e) == N_VAR || AST_KIND(e) == N_HOISTED;
+}
+
+/* the N_HOISTED node standing for invariant expression e in loop */
+static NodeId hoist_node(NodeId e, uint32_t loop) {
+    if (e >= hoist_seen_cap) {
+        uint32_t cap = hoist_seen_cap ? hoist_seen_cap : 1024;
+        while (cap <= e) cap *= 2;
+        hoist_seen = (HoistSeen*)realloc(hoist_seen, cap * sizeof(HoistSeen));
+        if (!hoist_seen) { perror("realloc"); exit(1); }
+        memset(hoist_seen + hoist_seen_cap, 0, (cap - hoist_seen_cap) * sizeof(HoistSeen));
+        hoist_seen_cap = cap;
+    }
+    if (hoist_seen[e].loop != loop + 1) {
+        Loop *lp = &loop_table[loop];
+        hoist_seen[e].loop = loop + 1;
+        hoist_seen[e].node = new_node_kind(N_HOISTED, OP_NONE, e, 0, (int)(lp->slot + lp->nslots++));
+        hoist_count++;
+    }
+    return hoist_seen[e].node;
+}
+
+/* e with the largest invariant expressions under it hoisted; *invariant
+   tells whether e itself is invariant (and then it is returned as is) */
+static NodeId hoist_under(NodeId stmt, NodeId e, const uint32_t *writes, uint32_t loop, int *invariant) {
+    switch (AST_KIND(e)) {
+        case N_INT: case N_CONST: case N_HOISTED:
+            *invariant = 1;
+            return e;
+        case N_VAR:
+            *invariant = AST_VALUE(e) < SHARED_BASE && !writes[AST_VALUE(e)];
+            return e;
+    }
+    int inv_l, inv_r = 1;
+    NodeId l = hoist_under(stmt, AST_LHS(e), writes, loop, &inv_l), r = AST_RHS(e);
+    if (r) r = hoist_under(stmt, r, writes, loop, &inv_r);
+    *invariant = inv_l && inv_r;
+    if (*invariant) return e;
+    if (inv_l && !is_leaf(l)) l = hoist_node(l, loop);
+    if (inv_r && r && !is_leaf(r)) r = hoist_node(r, loop);
+    if (l == AST_LHS(e) && r == AST_RHS(e)) return e;
+    NodeId copy = new_node_kind(AST_KIND(e), AST_OP(e), l, r, AST_VALUE(e));
+    use_copy(stmt, e, copy);
+    return copy;
+}
+
+static NodeId hoist_expr(NodeId stmt, NodeId e, const uint32_t *writes, uint32_t loop) {
+    int invariant;
+    e = hoist_under(stmt, e, writes, loop, &invariant);
+    return invariant && !is_leaf(e) ? hoist_node(e, loop) : e;
+}
+
+static void hoist_list(NodeId list, const uint32_t *writes, uint32_t loop);
+
+static void hoist_stmt(NodeId stmt, const uint32_t *writes, uint32_t loop) {
+    switch (AST_KIND(stmt)) {
+        case N_DECL: case N_ASSIGN:
+            AST_RHS(stmt) = hoist_expr(stmt, AST_RHS(stmt), writes, loop);
+            break;
+        case N_PRINT:
+            AST_LHS(stmt) = hoist_expr(stmt, AST_LHS(stmt), writes, loop);
+            break;
+        case N_MAPSET:
+            /* the value, then the key as for N_MAPDEL */
+            AST_RHS(stmt) = hoist_expr(stmt, AST_RHS(stmt), writes, loop);
+            /* fall through */
+        case N_MAPDEL:
+            AST_LHS(stmt) = hoist_expr(stmt, AST_LHS(stmt), writes, loop);
+            break;
+        case N_IF:
+            AST_LHS(stmt) = hoist_expr(stmt, AST_LHS(stmt), writes, loop);
+            hoist_list(AST_LHS(AST_RHS(stmt)), writes, loop);
+            hoist_list(AST_RHS(AST_RHS(stmt)), writes, loop);
+            break;
+        case N_SWITCH: {
+            /* the dispatch reads its variable directly; only the branches run */
+            const Switch *sw = &switch_table[AST_VALUE(stmt)];
+            for (uint32_t k = 0; k < sw->ncases; k++)
+                hoist_list(AST_LHS(AST_RHS(sw->ifs[k])), writes, loop);
+            hoist_list(AST_RHS(AST_RHS(sw->ifs[sw->ncases - 1])), writes, loop);
+            break;
+        }
+        case N_WHILE:
+            AST_LHS(stmt) = hoist_expr(stmt, AST_LHS(stmt), writes, loop);
+            hoist_list(AST_RHS(stmt), writes, loop);
+            break;
+    }
+}
+
+static void hoist_list(NodeId list, const uint32_t *writes, uint32_t loop) {
+    for (; list && AST_KIND(list) == N_STMTLIST; list = AST_LHS(list))
+        hoist_stmt(AST_RHS(list), writes, loop);
+}
+
+/* decide whether loop (its hoisting done) is unrolled; NULL if it is,
+   otherwise the reason it is not */
+static const char *loop_unroll(NodeId loop, Loop *lp, const uint32_t *writes) {
+    static const int mirror[] = { [OP_NE] = OP_NE, [OP_LE] = OP_GE, [OP_GE] = OP_LE,
+                                  [OP_LT] = OP_GT, [OP_GT] = OP_LT };
+    NodeId cond = AST_LHS(loop), var, bound;
+    if (unroll_factor <= 1) return "unrolling is off";
+    if (AST_KIND(cond) != N_OP || AST_OP(cond) < OP_NE)
+        return "the condition does not compare a variable with a bound";
+    int op = AST_OP(cond);
+    var = AST_LHS(cond);
+    bound = AST_RHS(cond);
+    if (AST_KIND(var) != N_VAR || !writes[AST_VALUE(var)]) {
+        NodeId t = var; var = bound; bound = t;
+        op = mirror[op];
+    }
+    /* an invariant bound is a constant, an unwritten variable or hoisted by now */
+    if (AST_KIND(var) != N_VAR || AST_VALUE(var) >= SHARED_BASE || !writes[AST_VALUE(var)] ||
+        !(is_const(bound) || AST_KIND(bound) == N_HOISTED ||
+          (AST_KIND(bound) == N_VAR && AST_VALUE(bound) < SHARED_BASE && !writes[AST_VALUE(bound)])))
+        return "the condition does not compare a variable with a bound";
+    int id = AST_VALUE(var);
+    if (writes[id] > 1) return "its variable is written more than once in the body";
+
+    /* the stepping statement, a top-level statement of the body (not inside
+       an if) so that it runs once per pass */
+    int64_t step = 0;
+    for (NodeId list = AST_RHS(loop); list && AST_KIND(list) == N_STMTLIST; list = AST_LHS(list)) {
+        NodeId stmt = AST_RHS(list), rhs = AST_RHS(stmt), l, r;
+        if (AST_KIND(stmt) != N_ASSIGN || AST_VALUE(AST_LHS(stmt)) != id) continue;
+        if (AST_KIND(rhs) != N_OP || (AST_OP(rhs) != OP_ADD && AST_OP(rhs) != OP_SUB)) break;
+        l = AST_LHS(rhs);
+        r = AST_RHS(rhs);
+        if (is_const(l) && AST_OP(rhs) == OP_ADD) { NodeId t = l; l = r; r = t; }
+        if (AST_KIND(l) == N_VAR && AST_VALUE(l) == id && is_const(r))
+            step = AST_OP(rhs) == OP_ADD ? AST_VALUE(r) : -(int64_t)AST_VALUE(r);
+        break;
+    }
+    if (!step) return "its variable is not stepped by a constant in a top-level statement of the body";
+    if (((op == OP_LT || op == OP_LE) && step < 0) || ((op == OP_GT || op == OP_GE) && step > 0))
+        return "its variable steps away from the bound";
+    /* a while's N_LOOP counts the tests after each pass: one per pass */
+    int64_t entries = profile_count(loop), passes = profile_count((NodeId)AST_VALUE(loop));
+    uint32_t unroll = unroll_factor;
+    if (entries > 0 && passes >= 0) {
+        if (passes < PROFILE_MIN_PASSES * entries) return "it made fewer than 2 passes per entry in the profile";
+        int64_t per_entry = (passes + entries - 1) / entries;
+        if (per_entry > unroll) unroll = per_entry < PROFILE_MAX_UNROLL ? (uint32_t)per_entry : PROFILE_MAX_UNROLL;
+    }
+    lp->var = id;
+    lp->op = op;
+    lp->bound = bound;
+    lp->step = step;
+    lp->unroll = unroll;
+    return NULL;
+}
+
+static void optimize_loops(NodeId list);
+
+static void optimize_loop(NodeId stmt) {
+    if (profile_count(stmt) == 0) {
+        opt_note(stmt, "while: did not run in the profile, left as is");
+        return;
+    }
+    if (loop_count == loop_cap) {
+        loop_cap = loop_cap ? loop_cap * 2 : 16;
+        loop_table = (Loop*)realloc(loop_table, loop_cap * sizeof(Loop));
+        if (!loop_table) { perror("realloc"); exit(1); }
+    }
+    uint32_t loop = (uint32_t)loop_count++;
+    Loop *lp = &loop_table[loop];
+    memset(lp, 0, sizeof *lp);
+    lp->slot = hoist_count;
+    lp->unroll = 1;
+    AST_VALUE((NodeId)AST_VALUE(stmt)) = (int)loop + 1;
+
+    uint32_t *writes = (uint32_t*)calloc(MAX_VARS, sizeof(uint32_t));
+    if (!writes) { perror("calloc"); exit(1); }
+    count_writes(AST_RHS(stmt), writes);
+    AST_LHS(stmt) = hoist_expr(stmt, AST_LHS(stmt), writes, loop);
+    hoist_list(AST_RHS(stmt), writes, loop);
+    if (lp->nslots)
+        opt_note(stmt, "while: %u invariant expression%s hoisted", lp->nslots, lp->nslots == 1 ? "" : "s");
+    else
+        opt_note(stmt, "while: no invariant expressions");
+    const char *why = loop_unroll(stmt, lp, writes);
+    if (why) {
+        opt_note(stmt, "while: not unrolled: %s", why);
+    } else {
+        static const char *op_text[] = { [OP_NE] = "!=", [OP_LE] = "<=", [OP_GE] = ">=",
+                                         [OP_LT] = "<", [OP_GT] = ">" };
+        opt_note(stmt, "while: unrolled by %u (%s %s bound, step %lld)", lp->unroll,
+                 variable_name(lp->var), op_text[lp->op], (long long)lp->step);
+    }
+    free(writes);
+    optimize_loops(AST_RHS(stmt));
+}
+
+static void optimize_loops_stmt(NodeId stmt) {
+    switch (AST_KIND(stmt)) {
+        case N_WHILE:
+            optimize_loop(stmt);
+            break;
+        case N_IF:
+            optimize_loops(AST_LHS(AST_RHS(stmt)));
+            optimize_loops(AST_RHS(AST_RHS(stmt)));
+            break;
+        case N_SWITCH: {
+            uint32_t ncases = switch_table[AST_VALUE(stmt)].ncases;
+            for (uint32_t k = 0; k < ncases; k++)
+                optimize_loops(AST_LHS(AST_RHS(switch_table[AST_VALUE(stmt)].ifs[k])));
+            optimize_loops(AST_RHS(AST_RHS(switch_table[AST_VALUE(stmt)].ifs[ncases - 1])));
+            break;
+        }
+    }
+}
+
+static void optimize_loops(NodeId list) {
+    for (; list && AST_KIND(list) == N_STMTLIST; list = AST_LHS(list))
+        optimize_loops_stmt(AST_RHS(list));
+}
+
+/* ---- constant folding (-O) ----
+   Before the other passes, expressions whose value is known before the
+   program runs are replaced by N_CONST nodes: operators on constants, and
+   variables whose value is known at that point. A variable is known after
+   `int x = c;`, and `x = c;` keeps it known; any other write forgets it.
+   The statements are walked in the order they run: an if continues with
+   what both of its branches agree on, and a loop forgets the variables its
+   body writes before its condition and body are folded. Folded constants
+   then fold the expressions around them, so chains and loop bounds see
+   them too. Nothing that could fail is folded (division by zero, values
+   out of int range), and shared variables are never known. As with the
+   other -O nodes, tree.txt prints the expression an N_CONST stands for. */
+typedef struct Known {
+    uint8_t set[MAX_VARS];
+    int value[MAX_VARS];
+} Known;
+
+static int fold_op(int op, int64_t l, int64_t r, int *value) {
+    int64_t v;
+    switch (op) {
+        case OP_ADD: v = l + r; break;
+        case OP_SUB: v = l - r; break;
+        case OP_MUL: v = l * r; break;
+        case OP_DIV:
+            if (r == 0) return 0;
+            v = l / r;
+            break;
+        case OP_EQ: v = l == r; break;
+        case OP_NE: v = l != r; break;
+        case OP_LE: v = l <= r; break;
+        case OP_GE: v = l >= r; break;
+        case OP_LT: v = l < r; break;
+        case OP_GT: v = l > r; break;
+        default: return 0;
+    }
+    if (v < INT_MIN || v > INT_MAX) return 0;
+    *value = (int)v;
+    return 1;
+}
+
+/* e, an expression of stmt, with what is known folded; counts the N_CONST
+   nodes made in *folded */
+static NodeId fold_expr(NodeId stmt, NodeId e, const Known *known, uint32_t *folded) {
+    switch (AST_KIND(e)) {
+        case N_VAR: {
+            int id = AST_VALUE(e);
+            if (id >= SHARED_BASE || !known->set[id]) return e;
+            ++*folded;
+            return hashcons_node(N_CONST, OP_NONE, e, 0, known->value[id]);
+        }
+        case N_INDEX: {
+            /* the map itself is never a constant */
+            NodeId key = fold_expr(stmt, AST_RHS(e), known, folded);
+            if (key == AST_RHS(e)) return e;
+            NodeId index = hashcons_node(N_INDEX, OP_NONE, AST_LHS(e), key, 0);
+            use_copy(stmt, e, index);
+            return index;
+        }
+        case N_OP: {
+            uint32_t below = *folded;
+            NodeId l = fold_expr(stmt, AST_LHS(e), known, folded), r = fold_expr(stmt, AST_RHS(e), known, folded);
+            int value;
+            if (is_const(l) && is_const(r) && fold_op(AST_OP(e), AST_VALUE(l), AST_VALUE(r), &value)) {
+                /* one constant stands for the whole expression */
+                *folded = below + 1;
+                return hashcons_node(N_CONST, OP_NONE, e, 0, value);
+            }
+            if (l == AST_LHS(e) && r == AST_RHS(e)) return e;
+            NodeId op = hashcons_node(N_OP, AST_OP(e), l, r, 0);
+            use_copy(stmt, e, op);
+            return op;
+        }
+    }
+    return e;
+}
+
+static void fold_list(NodeId list, Known *known);
+
+static void fold_stmt(NodeId stmt, Known *known) {
+    uint32_t folded = 0;
+    int id;
+    switch (AST_KIND(stmt)) {
+        case N_DECL: case N_ASSIGN:
+            id = AST_VALUE(AST_LHS(stmt));
+            AST_RHS(stmt) = fold_expr(stmt, AST_RHS(stmt), known, &folded);
+            if (id >= SHARED_BASE) break;
+            /* an assignment fails on an undeclared variable: only a known
+               one is certainly declared */
+            if (is_const(AST_RHS(stmt)) && (AST_KIND(stmt) == N_DECL || known->set[id])) {
+                known->set[id] = 1;
+                known->value[id] = AST_VALUE(AST_RHS(stmt));
+            } else {
+                known->set[id] = 0;
+            }
+            break;
+        case N_PRINT:
+            AST_LHS(stmt) = fold_expr(stmt, AST_LHS(stmt), known, &folded);
+            break;
+        case N_MAPDECL:
+            known->set[AST_VALUE(AST_LHS(stmt))] = 0;
+            break;
+        case N_MAPSET:
+            /* the value, then the key as for N_MAPDEL */
+            AST_RHS(stmt) = fold_expr(stmt, AST_RHS(stmt), known, &folded);
+            /* fall through */
+        case N_MAPDEL:
+            AST_LHS(stmt) = fold_expr(stmt, AST_LHS(stmt), known, &folded);
+            break;
+        case N_IF: {
+            AST_LHS(stmt) = fold_expr(stmt, AST_LHS(stmt), known, &folded);
+            /* a failing condition runs neither branch: keep what holds
+               before the if and after both */
+            Known *then = (Known*)malloc(sizeof(Known)), *other = (Known*)malloc(sizeof(Known));
+            if (!then || !other) { perror("malloc"); exit(1); }
+            memcpy(then, known, sizeof(Known));
+            memcpy(other, known, sizeof(Known));
+            fold_list(AST_LHS(AST_RHS(stmt)), then);
+            fold_list(AST_RHS(AST_RHS(stmt)), other);
+            for (int i = 0; i < MAX_VARS; i++)
+                if (!then->set[i] || then->value[i] != known->value[i] ||
+                    !other->set[i] || other->value[i] != known->value[i]) known->set[i] = 0;
+            free(then);
+            free(other);
+            break;
+        }
+        case N_WHILE: {
+            uint32_t *writes = (uint32_t*)calloc(MAX_VARS, sizeof(uint32_t));
+            if (!writes) { perror("calloc"); exit(1); }
+            count_writes(AST_RHS(stmt), writes);
+            for (int i = 0; i < MAX_VARS; i++)
+                if (writes[i]) known->set[i] = 0;
+            free(writes);
+            AST_LHS(stmt) = fold_expr(stmt, AST_LHS(stmt), known, &folded);
+            /* what the body learns holds only inside it */
+            Known *inside = (Known*)malloc(sizeof(Known));
+            if (!inside) { perror("malloc"); exit(1); }
+            memcpy(inside, known, sizeof(Known));
+            fold_list(AST_RHS(stmt), inside);
+            free(inside);
+            break;
+        }
+    }
+    if (folded) opt_note(stmt, "%u constant%s folded", folded, folded == 1 ? "" : "s");
+}
+
+static void fold_list(NodeId list, Known *known) {
+    /* the list is linked from its last statement: collect it to walk it in order */
+    size_t n = 0, cap = 16;
+    NodeId *stmts = (NodeId*)malloc(cap * sizeof(NodeId));
+    if (!stmts) { perror("malloc"); exit(1); }
+    for (; list && AST_KIND(list) == N_STMTLIST; list = AST_LHS(list)) {
+        if (n == cap) {
+            cap *= 2;
+            stmts = (NodeId*)realloc(stmts, cap * sizeof(NodeId));
+            if (!stmts) { perror("realloc"); exit(1); }
+        }
+        stmts[n++] = AST_RHS(list);
+    }
+    while (n) fold_stmt(stmts[--n], known);
+    free(stmts);
+}
+
+/* run the optimizer on a parsed program, noting what it did to report
+   (NULL: no notes) */
+void optimize_program(NodeId root, FILE *report) {
+    opt_report = report;
+    Known *known = (Known*)calloc(1, sizeof(Known));
+    if (!known) { perror("calloc"); exit(1); }
+    fold_list(root, known);
+    free(known);
+    lower_chains(root);
+    optimize_loops(root);
+    free(hoist_seen);
+    hoist_seen = NULL;
+    hoist_seen_cap = 0;
+    if (report) opt_notes_write();
+    opt_report = NULL;
+}
+
+void optimizer_free(void) {
+    switch_free();
+    free(profile);
+    profile = NULL;
+    profile_nodes = 0;
+    free(loop_table);
+    loop_table = NULL;
+    loop_count = loop_cap = 0;
+    hoist_count = 0;
+}
+
+/* a while is entered: the values kept for its hoisted expressions are
+   from an earlier run of the loop */
+static void loop_enter(Exec *ex, NodeId loop) {
+    uint32_t k = (uint32_t)AST_VALUE((NodeId)AST_VALUE(loop));
+    if (!k) return;
+    const Loop *lp = &loop_table[k - 1];
+    for (uint32_t i = lp->slot; i < lp->slot + lp->nslots && i < ex->nhoisted; i++)
+        ex->hoisted_set[i] = 0;
+}
+
+static void hoist_keep(Exec *ex, uint32_t slot, int value) {
+    if (slot >= ex->nhoisted) {
+        uint32_t n = hoist_count;
+        if (slot >= n || !mem_charge_spare(ex->mem, (n - ex->nhoisted) * (sizeof(int) + 1))) return;
+        ex->hoisted = (int*)realloc(ex->hoisted, n * sizeof(int));
+        ex->hoisted_set = (uint8_t*)realloc(ex->hoisted_set, n);
+        if (!ex->hoisted || !ex->hoisted_set) { perror("realloc"); exit(1); }
+        memset(ex->hoisted_set + ex->nhoisted, 0, n - ex->nhoisted);
+        ex->nhoisted = n;
+    }
+    ex->hoisted[slot] = value;
+    ex->hoisted_set[slot] = 1;
+}
+
+int eval_expr(Exec *ex, NodeId n);
+
+/* passes of an unrolled loop left before its condition, true now, turns
+   false (0: unknown) */
+static int64_t loop_passes(Exec *ex, const Loop *lp) {
+    int64_t gap = (int64_t)eval_expr(ex, lp->bound) - var_value(ex, lp->var), step = lp->step;
+    switch (lp->op) {
+        case OP_LT: return (gap + step - 1) / step;
+        case OP_LE: return gap / step + 1;
+        case OP_GT: return (gap + step + 1) / step;
+        case OP_GE: return gap / step + 1;
+        case OP_NE: return gap % step == 0 && gap / step > 0 ? gap / step : 0;
+    }
+    return 0;
+}
+
+/* test the condition of a while; while it holds, schedule the body (more
+   than once when unrolled) and then the next test */
+static void loop_test(Exec *ex, NodeId loop) {
+    ex->runtime_error = 0;
+    int cond = eval_expr(ex, AST_LHS(loop));
+    if (ex->runtime_error || !cond) return;
+    NodeId back = (NodeId)AST_VALUE(loop);
+    int64_t passes = 1;
+    if (AST_VALUE(back) && loop_table[AST_VALUE(back) - 1].unroll > 1) {
+        const Loop *lp = &loop_table[AST_VALUE(back) - 1];
+        passes = loop_passes(ex, lp);
+        if (passes < 1) passes = 1;
+        if (passes > lp->unroll) passes = lp->unroll;
+    }
+    exec_push(ex, back);
+    while (passes--) exec_push_list(ex, AST_RHS(loop));
+}
+
+/* ---- evaluation of expressions at execution time ---- */
+
+/* the table of the map variable of index (an m[k] in the running
+   statement); reports an error and returns NULL if there is none */
+static IntMap *index_map(Exec *ex, NodeId index, int for_write) {
+    int id = AST_VALUE(AST_LHS(index));
+    const char *msg = "Indexing a variable that is not a map";
+    if (!var_declared(ex, id)) msg = for_write ? "Assignment to undeclared variable" : "Use of undeclared variable";
+    IntMap *m = var_map(ex, id, for_write);
+    if (m || ex->alloc_failed) return m;
+    semantic_error_at(msg, ex->stmt, index);
+    ex->runtime_error = 1;
+    return NULL;
+}
+
+int eval_expr(Exec *ex, NodeId n) {
+    if (!n) return 0;
+    switch (AST_KIND(n)) {
+        case N_INT:
+            return AST_VALUE(n);
+        case N_VAR:
+            switch (var_declared(ex, AST_VALUE(n))) {
+                case 0:
+                    semantic_error_at("Use of undeclared variable", ex->stmt, n);
+                    ex->runtime_error = 1;
+                    return 0;
+                case VAR_MAP:
+                    semantic_error_at("Map used as a value", ex->stmt, n);
+                    ex->runtime_error = 1;
+                    return 0;
+            }
+            return var_value(ex, AST_VALUE(n));
+        case N_INDEX: {
+            IntMap *m = index_map(ex, n, 0);
+            if (!m) return 0;
+            int key = eval_expr(ex, AST_RHS(n));
+            if (ex->runtime_error) return 0;
+            int value;
+            if (!map_get(m, key, &value)) {
+                semantic_error_at("Key not found in map", ex->stmt, n);
+                ex->runtime_error = 1;
+                return 0;
+            }
+            return value;
+        }
+        case N_CONST:
+            return AST_VALUE(n);
+        case N_HOISTED: {
+            uint32_t slot = (uint32_t)AST_VALUE(n);
+            if (slot < ex->nhoisted && ex->hoisted_set[slot]) return ex->hoisted[slot];
+            /* only a value computed without an error is kept */
+            int failed = ex->runtime_error;
+            ex->runtime_error = 0;
+            int value = eval_expr(ex, AST_LHS(n));
+            if (!ex->runtime_error) hoist_keep(ex, slot, value);
+            ex->runtime_error |= failed;
+            return value;
+        }
+        case N_OP: {
+            int L = eval_expr(ex, AST_LHS(n));
+            int R = eval_expr(ex, AST_RHS(n));
+            switch (AST_OP(n)) {
+                /* arithmetic */
+                case OP_ADD: return L + R;
+                case OP_SUB: return L - R;
+                case OP_MUL: return L * R;
+                case OP_DIV:
+                    if (R == 0) { semantic_error_at("Division by zero", ex->stmt, n); ex->runtime_error = 1; return 0; }
+                    return L / R;
+                /* comparisons -> return 0/1 */
+                case OP_EQ: return (L == R);
+                case OP_NE: return (L != R);
+                case OP_LE: return (L <= R);
+                case OP_GE: return (L >= R);
+                case OP_LT: return (L < R);
+                case OP_GT: return (L > R);
+            }
+            /* unknown op */
+            semantic_error("Unknown operator in eval_expr", ex->stmt);
+            return 0;
+        }
+        default:
+            semantic_error("eval_expr: expected expression node", ex->stmt);
+            return 0;
+    }
+}
+
+/* assignment to a shared variable: x = x + e, x = e + x and x = x - e are
+   applied as one atomic add; returns the value assigned */
+static int shared_assign(Exec *ex, int id, NodeId rhs) {
+    if (AST_KIND(rhs) == N_OP && (AST_OP(rhs) == OP_ADD || AST_OP(rhs) == OP_SUB)) {
+        NodeId l = AST_LHS(rhs), r = AST_RHS(rhs);
+        int l_is_x = AST_KIND(l) == N_VAR && AST_VALUE(l) == id;
+        int r_is_x = AST_KIND(r) == N_VAR && AST_VALUE(r) == id;
+        if (l_is_x || (r_is_x && AST_OP(rhs) == OP_ADD)) {
+            int delta = eval_expr(ex, l_is_x ? r : l);
+            if (ex->runtime_error) return 0;
+            return shared_add(id, AST_OP(rhs) == OP_SUB ? -delta : delta);
+        }
+    }
+    int val = eval_expr(ex, rhs);
+    if (!ex->runtime_error) shared_store(id, val);
+    return val;
+}
+
+static void debugger_trap(Exec *ex, NodeId stmt);
+
+/* run a statement as a node of the given kind; the statements of a chosen
+   if branch are pushed and run by the following steps */
+static void exec_kind(Exec *ex, NodeId stmt, int kind) {
+    ex->stmt = stmt;
+    switch (kind) {
+        case N_DECL: {
+            /* left is var node, right is expression node */
+            COVER(ex, stmt);
+            ex->runtime_error = 0;
+            int val = eval_expr(ex, AST_RHS(stmt));
+            if (ex->runtime_error) return;
+            NodeId varNode = AST_LHS(stmt);
+            if (AST_KIND(varNode) == N_VAR) {
+                int id = AST_VALUE(varNode);
+                var_store(ex, id, val, 1); /* mark as declared */
+                out_printf(&ex->out, "STORE var[%d] = %d\n", id, val);
+            } else {
+                semantic_error("Declaration left side is not a variable", stmt);
+            }
+            break;
+        }
+        case N_ASSIGN: {
+            COVER(ex, stmt);
+            ex->runtime_error = 0;
+            if (AST_KIND(AST_LHS(stmt)) == N_VAR && AST_VALUE(AST_LHS(stmt)) >= SHARED_BASE) {
+                int id = AST_VALUE(AST_LHS(stmt));
+                int val = shared_assign(ex, id, AST_RHS(stmt));
+                if (ex->runtime_error) return;
+                out_printf(&ex->out, "MOV var[%d] = %d\n", id, val);
+                break;
+            }
+            int val = eval_expr(ex, AST_RHS(stmt));
+            if (ex->runtime_error) return;
+            NodeId varNode = AST_LHS(stmt);
+            if (AST_KIND(varNode) == N_VAR) {
+                int id = AST_VALUE(varNode);
+                if (!var_declared(ex, id)) {
+                    semantic_error("Assignment to undeclared variable", stmt);
+                    return;
+                }
+                if (var_declared(ex, id) == VAR_MAP) {
+                    semantic_error("Assignment to a map variable", stmt);
+                    return;
+                }
+                var_store(ex, id, val, 0);
+                out_printf(&ex->out, "MOV var[%d] = %d\n", id, val);
+            } else {
+                semantic_error("Assignment left side is not a variable", stmt);
+            }
+            break;
+        }
+        case N_PRINT: {
+            COVER(ex, stmt);
+            ex->runtime_error = 0;
+            int val = eval_expr(ex, AST_LHS(stmt));
+            if (ex->runtime_error) return;
+            out_printf(&ex->out, "Print: %d\n", val);
+            break;
+        }
+        case N_IF: {
+            ex->runtime_error = 0;
+            int cond_val = eval_expr(ex, AST_LHS(stmt));
+            if (ex->runtime_error) return;
+            NodeId branches = AST_RHS(stmt); /* branches node: left=thenList, right=elseList */
+            if (branches && AST_KIND(branches) == N_BRANCHES) {
+                COVER(ex, cond_val ? stmt : branches);
+                exec_push_list(ex, cond_val ? AST_LHS(branches) : AST_RHS(branches));
+            } else {
+                semantic_error("If branches malformed", stmt);
+            }
+            break;
+        }
+        case N_WHILE:
+            COVER(ex, stmt);
+            loop_enter(ex, stmt);
+            loop_test(ex, stmt);
+            break;
+        case N_LOOP:
+            /* errors in the condition are located at the while */
+            ex->stmt = AST_LHS(stmt);
+            COVER(ex, stmt);
+            loop_test(ex, AST_LHS(stmt));
+            break;
+        case N_SWITCH: {
+            const Switch *sw = &switch_table[AST_VALUE(stmt)];
+            ex->runtime_error = 0;
+            int x = eval_expr(ex, sw->var);
+            if (ex->runtime_error) return;
+            uint32_t k = switch_case(sw, x), last = sw->ncases - 1;
+            /* the ifs the chain would have tested after this one */
+            for (uint32_t i = 1; !ex->no_tree && i <= (k < sw->ncases ? k : last); i++)
+                switch_tree(&ex->tree, ex->mem, sw, i);
+            NodeId branches = AST_RHS(sw->ifs[k < sw->ncases ? k : last]);
+            exec_push_list(ex, k < sw->ncases ? AST_LHS(branches) : AST_RHS(branches));
+            break;
+        }
+        case N_MAPDECL: {
+            COVER(ex, stmt);
+            int id = AST_VALUE(AST_LHS(stmt));
+            if (id >= SHARED_BASE) {
+                semantic_error("A shared variable cannot be a map", stmt);
+                ex->runtime_error = 1;
+                return;
+            }
+            var_set_map(ex, id, map_new());
+            out_printf(&ex->out, "MAP var[%d]\n", id);
+            break;
+        }
+        case N_MAPSET: {
+            COVER(ex, stmt);
+            ex->runtime_error = 0;
+            NodeId index = AST_LHS(stmt);
+            int key = eval_expr(ex, AST_RHS(index));
+            if (ex->runtime_error) return;
+            int val = eval_expr(ex, AST_RHS(stmt));
+            if (ex->runtime_error) return;
+            IntMap *m = index_map(ex, index, 1);
+            if (!m || !map_put(m, key, val, ex->mem)) {
+                if (m) ex->alloc_failed = 1;
+                return;
+            }
+            out_printf(&ex->out, "MOV var[%d][%d] = %d\n", AST_VALUE(AST_LHS(index)), key, val);
+            break;
+        }
+        case N_MAPDEL: {
+            COVER(ex, stmt);
+            ex->runtime_error = 0;
+            NodeId index = AST_LHS(stmt);
+            int key = eval_expr(ex, AST_RHS(index));
+            if (ex->runtime_error) return;
+            IntMap *m = index_map(ex, index, 1);
+            if (!m) return;
+            if (!map_del(m, key)) {
+                semantic_error_at("Key not found in map", stmt, index);
+                ex->runtime_error = 1;
+                return;
+            }
+            out_printf(&ex->out, "DEL var[%d][%d]\n", AST_VALUE(AST_LHS(index)), key);
+            break;
+        }
+        case N_STMTLIST: {
+            /* If accidentally a stmtlist passed directly, execute it */
+            exec_push_list(ex, stmt);
+            break;
+        }
+        case N_TRAP:
+            debugger_trap(ex, stmt);
+            break;
+        default:
+            semantic_error("Unknown statement kind in execute_stmt", stmt);
+            break;
+    }
+}
+
+/* execute a single statement node */
+void execute_stmt(Exec *ex, NodeId stmt) {
+    if (!stmt) return;
+
+    /* Print the statement tree to tree.txt before executing (so tree.txt reflects executed statements);
+       a while prints its tree once, when it is entered, and not before each test */
+    if (AST_KIND(stmt) != N_LOOP && !ex->no_tree) print_tree_header(&ex->tree, stmt);
+
+    exec_kind(ex, stmt, AST_KIND(stmt));
+}
+
+/* ---- statement budget and deadline ----
+   exec_run() only decrements ex->fuel per statement. When it runs out,
+   exec_refuel() checks the limits: it hands out the next part of the
+   budget, and with a deadline at most DEADLINE_CHECK statements at a time,
+   so the clock is read once per DEADLINE_CHECK statements. A program over
+   either limit is stopped with an error located at the statement that
+   would have run next; with -checkpoint it is saved instead, to be resumed
+   with -restore. Periodic checkpoints are taken here too. */
+#define DEADLINE_CHECK 1024
+
+static int exec_refuel(Exec *ex, NodeId next) {
+    const char *msg = NULL;
+    if (ex->checkpoint_every && ex->issued >= ex->next_checkpoint) {
+        exec_checkpoint(ex, ex->checkpoint);
+        ex->next_checkpoint = ex->issued + ex->checkpoint_every;
+    }
+    if ((ex->deadline && now_seconds() > ex->deadline) || (ex->budget == 0 && ex->budget_is_deadline)) {
+        msg = "Deadline exceeded";
+        ex->deadline_hit = 1;
+    } else if (ex->budget == 0) {
+        msg = "Statement budget exceeded";
+    }
+    if (msg) {
+        if (ex->checkpoint) exec_checkpoint(ex, ex->checkpoint);
+        else semantic_error(msg, next);
+        ex->stopped = 1;
+        return 0;
+    }
+    uint64_t fuel = ex->budget;
+    if (ex->deadline && fuel > DEADLINE_CHECK) fuel = DEADLINE_CHECK;
+    if (ex->checkpoint_every && fuel > ex->next_checkpoint - ex->issued)
+        fuel = ex->next_checkpoint - ex->issued;
+    ex->fuel = fuel;
+    if (ex->budget != UINT64_MAX) ex->budget -= fuel;
+    ex->issued += fuel;
+    return 1;
+}
+
+/* run up to `slice` statements (0: no limit); returns 1 while statements
+   remain */
+int exec_run(Exec *ex, uint32_t slice) {
+    uint32_t steps = 0;
+    if (ex->stopped) ex->depth = 0;
+    while (ex->depth) {
+        if (slice && steps++ == slice) return 1;
+        NodeId stmt = ex->stack[ex->depth - 1];
+        if (ex->fuel == 0 && !exec_refuel(ex, stmt)) { ex->depth = 0; return 0; }
+        ex->fuel--;
+        ex->depth--;
+        if (ex->mem && atomic_load_explicit(&ex->mem->exceeded, memory_order_relaxed)) {
+            /* already reported (with -pipeline, by the parser) */
+            ex->stopped = 1;
+            ex->depth = 0;
+            return 0;
+        }
+        execute_stmt(ex, stmt);
+        if (ex->alloc_failed || ex->out.full || ex->tree.full) {
+            semantic_error("Memory limit exceeded", stmt);
+            ex->stopped = 1;
+            ex->depth = 0;
+            return 0;
+        }
+    }
+    return 0;
+}
+
+/* execute a list-of-statements node (stmtlist) to the end */
+void execute_list(Exec *ex, NodeId list) {
+    exec_push_list(ex, list);
+    exec_run(ex, 0);
+}
+
+/* ---- debugger ----
+   -debug runs the program under a line-based command protocol on
+   stdin/stdout. Commands are read before the first statement and whenever
+   the program stops:
+     break LINE / clear LINE   set / remove a breakpoint on the statements of LINE
+     watch NAME / unwatch NAME stop after a statement changes variable NAME
+     print NAME                show a variable
+     vars                      show every declared variable (sym[])
+     where                     show the line of the next statement
+     step                      run one statement and stop
+     continue                  run to the next breakpoint or watchpoint
+     quit                      stop the program
+   Every reply ends with a line "ok" or "error: ...". A watchpoint patches
+   every statement that assigns the variable, so it is free too; a map
+   stops after each statement that declares it, sets a key or deletes one.
+   When
+   stdin ends, the program runs to the end. */
+int variable_lookup(const char *name);  /* scanner.l */
+
+static int debug_stepping = 0;          /* trap the next statement to run */
+
+/* patch (set) or unpatch every statement starting on line; returns the count */
+static int debug_break(int line, int set) {
+    int n = 0;
+    for (uint32_t i = 0; i < loc_count; i++) {
+        NodeId stmt = loc_table[i].node;
+        if (stmt_line(stmt) != line) continue;
+        if (set) trap_set(stmt, TRAP_BREAK);
+        else trap_clear(stmt, TRAP_BREAK);
+        /* a while stops before each test of its condition */
+        if (stmt_kind(stmt) == N_WHILE) {
+            if (set) trap_set((NodeId)AST_VALUE(stmt), TRAP_BREAK);
+            else trap_clear((NodeId)AST_VALUE(stmt), TRAP_BREAK);
+        }
+        n++;
+    }
+    return n;
+}
+
+/* variable written by a statement of the given kind (-1: none), as in
+   count_writes_stmt */
+static int written_var(NodeId stmt, int kind) {
+    switch (kind) {
+        case N_DECL: case N_ASSIGN: case N_MAPDECL:
+            return AST_VALUE(AST_LHS(stmt));
+        case N_MAPSET: case N_MAPDEL:
+            return AST_VALUE(AST_LHS(AST_LHS(stmt)));
+    }
+    return -1;
+}
+
+/* patch (set) or unpatch every statement assigning variable id */
+static int debug_watch(int id, int set) {
+    int n = 0;
+    for (uint32_t i = 0; i < loc_count; i++) {
+        NodeId stmt = loc_table[i].node;
+        if (written_var(stmt, stmt_kind(stmt)) != id) continue;
+        if (set) trap_set(stmt, TRAP_WATCH);
+        else trap_clear(stmt, TRAP_WATCH);
+        n++;
+    }
+    return n;
+}
+
+static const char *debug_name(int id) {
+    return id >= SHARED_BASE ? shared_vars[id - SHARED_BASE].name : variable_name(id);
+}
+
+static void debug_show(Exec *ex, int id) {
+    if (var_declared(ex, id) == VAR_MAP) printf("%s = map of %u keys\n", debug_name(id), var_map(ex, id, 0)->size);
+    else if (var_declared(ex, id)) printf("%s = %d\n", debug_name(id), var_value(ex, id));
+    else printf("%s is not declared\n", debug_name(id));
+}
+
+/* read and run commands until one resumes the program */
+void debugger_prompt(Exec *ex, NodeId next) {
+    char line[256], cmd[32], arg[200];
+    debug_stepping = 0;
+    for (;;) {
+        fflush(stdout);
+        if (!fgets(line, sizeof line, stdin)) return;   /* detached: run on */
+        arg[0] = '\0';
+        if (sscanf(line, "%31s %199s", cmd, arg) < 1) continue;
+        if (strcmp(cmd, "continue") == 0 || strcmp(cmd, "c") == 0) {
+            printf("ok\n");
+            return;
+        } else if (strcmp(cmd, "step") == 0 || strcmp(cmd, "s") == 0) {
+            debug_stepping = 1;
+            printf("ok\n");
+            return;
+        } else if (strcmp(cmd, "quit") == 0) {
+            ex->stopped = 1;
+            ex->depth = 0;
+            printf("ok\n");
+            return;
+        } else if (strcmp(cmd, "break") == 0 || strcmp(cmd, "clear") == 0) {
+            int n = debug_break(atoi(arg), cmd[0] == 'b');
+            if (n) printf("%d statement(s) on line %d\nok\n", n, atoi(arg));
+            else printf("error: no statement starts on line %s\n", arg);
+        } else if (strcmp(cmd, "watch") == 0 || strcmp(cmd, "unwatch") == 0) {
+            int id = variable_lookup(arg);
+            if (id < 0) printf("error: no variable %s\n", arg);
+            else printf("%d statement(s) assign %s\nok\n", debug_watch(id, cmd[0] == 'w'), arg);
+        } else if (strcmp(cmd, "print") == 0 || strcmp(cmd, "p") == 0) {
+            int id = variable_lookup(arg);
+            if (id < 0) printf("error: no variable %s\n", arg);
+            else { debug_show(ex, id); printf("ok\n"); }
+        } else if (strcmp(cmd, "vars") == 0) {
+            for (int id = 1; id < MAX_VARS; id++)
+                if (var_declared(ex, id) && debug_name(id)[0]) debug_show(ex, id);
+            printf("ok\n");
+        } else if (strcmp(cmd, "where") == 0) {
+            if (next) printf("line %d\nok\n", stmt_line(next));
+            else printf("error: no statement to run\n");
+        } else {
+            printf("error: unknown command %s\n", cmd);
+        }
+    }
+}
+
+/* after a command asked to step, trap whatever statement runs next */
+static void debug_after_stmt(Exec *ex) {
+    if (debug_stepping && ex->depth) {
+        debug_stepping = 0;
+        trap_set(ex->stack[ex->depth - 1], TRAP_STEP);
+    }
+}
+
+/* a patched statement was reached: report, run it with its real kind */
+static void debugger_trap(Exec *ex, NodeId stmt) {
+    Trap *t = trap_find(stmt);
+    int kind = t->kind, flags = t->flags;
+    if (flags & TRAP_STEP) trap_clear(stmt, TRAP_STEP);
+    if (flags & (TRAP_BREAK | TRAP_STEP)) {
+        printf("stopped at line %d (%s)\n", stmt_line(stmt), flags & TRAP_BREAK ? "breakpoint" : "step");
+        debugger_prompt(ex, stmt);
+        if (ex->stopped) return;
+    }
+    int id = written_var(stmt, kind), is_map = kind != N_DECL && kind != N_ASSIGN;
+    int was_declared = 0, old = 0;
+    if (flags & TRAP_WATCH) {
+        was_declared = var_declared(ex, id);
+        /* a map is shown by its number of keys */
+        old = was_declared == VAR_MAP ? (int)var_map(ex, id, 0)->size : var_value(ex, id);
+        ex->runtime_error = 0;
+    }
+    exec_kind(ex, stmt, kind);
+    if ((flags & TRAP_WATCH) && !ex->stopped && !ex->alloc_failed) {
+        int hit = 0;
+        if (is_map && !ex->runtime_error && var_declared(ex, id) == VAR_MAP) {
+            /* every write that succeeded stops, even one storing the value
+               a key already had */
+            printf("watch %s: ", debug_name(id));
+            if (kind == N_MAPDECL) printf("declared = map");
+            else printf("%d -> %u keys", old, var_map(ex, id, 0)->size);
+            hit = 1;
+        } else if (!is_map && var_declared(ex, id) && (!was_declared || var_value(ex, id) != old)) {
+            printf("watch %s: ", debug_name(id));
+            if (was_declared) printf("%d -> %d", old, var_value(ex, id));
+            else printf("declared = %d", var_value(ex, id));
+            hit = 1;
+        }
+        if (hit) {
+            printf(" at line %d\n", stmt_line(stmt));
+            debugger_prompt(ex, ex->depth ? ex->stack[ex->depth - 1] : 0);
+        }
+    }
+    debug_after_stmt(ex);
+}
+
+/* -debug: take commands before the first statement, then run */
+void debugger_start(Exec *ex) {
+    printf("program loaded: %u statement(s)\n", loc_count);
+    debugger_prompt(ex, ex->depth ? ex->stack[ex->depth - 1] : 0);
+    debug_after_stmt(ex);
+}
+
+/* ---- checkpoint and restore ----
+   -checkpoint FILE saves a running program so that a later process can
+   resume it with -restore FILE: the symbol table, the statement stack (the
+   program counter) and how far out.txt, tree.txt and outError.txt had been
+   written. Statements are saved as NodeIds, which are valid again once the
+   same program is parsed again, so the file also carries a hash of the
+   AST and the restore is refused if the program has changed. The file is
+   binary in host byte order, like the -dump-tokens file: header, declared
+   flags, values, stack, then for every map its size and key/value pairs. */
+#define CHECKPOINT_MAGIC 0x32504b43u  /* "CKP2" */
+
+typedef struct CheckpointHeader {
+    uint32_t magic;
+    uint32_t nvars;             /* variable slots saved: highest declared id + 1 */
+    uint64_t ast_hash;          /* ast_hash() of the parsed program */
+    uint64_t out_offset, tree_offset, error_offset;
+    uint64_t steps;             /* statements run so far */
+    uint32_t depth;             /* statements on the stack */
+    uint32_t node_count;        /* ast_count */
+    uint32_t nmaps;             /* tables of map variables */
+} CheckpointHeader;
+
+/* FNV-1a over every node, identifying the parsed program */
+uint64_t ast_hash(void) {
+    uint64_t h = 14695981039346656037ull;
+    for (NodeId n = 1; n < ast_count; n++) {
+        uint32_t fields[5] = { AST_KIND(n), AST_OP(n), AST_LHS(n), AST_RHS(n), (uint32_t)AST_VALUE(n) };
+        const unsigned char *p = (const unsigned char*)fields;
+        for (size_t i = 0; i < sizeof fields; i++) {
+            h ^= p[i];
+            h *= 1099511628211ull;
+        }
+    }
+    return h;
+}
+
+/* bytes written to an output so far (buffered text included) */
+static uint64_t output_offset(FILE *f) {
+    if (!f) return 0;
+    fflush(f);
+    long pos = ftell(f);
+    return pos < 0 ? 0 : (uint64_t)pos;
+}
+
+/* write the checkpoint to path.tmp and rename it over path, so an
+   interrupted write never replaces a good checkpoint */
+int exec_checkpoint(Exec *ex, const char *path) {
+    char tmp[4096];
+    CheckpointHeader h;
+    uint8_t declared[MAX_VARS];
+    int sym[MAX_VARS];
+
+    out_flush(&ex->out);
+    out_flush(&ex->tree);
+    memset(&h, 0, sizeof h);
+    h.magic = CHECKPOINT_MAGIC;
+    for (int id = 0; id < SHARED_BASE; id++)   /* shared variables are not the program's */
+        if (var_declared(ex, id)) h.nvars = (uint32_t)id + 1;
+    h.ast_hash = ast_hash();
+    h.out_offset = output_offset(ex->out.file);
+    h.tree_offset = output_offset(ex->tree.file);
+    if (diag_format) diag_flush(yyError);   /* a restored run continues after them */
+    h.error_offset = yyError == stderr ? 0 : output_offset(yyError);
+    h.steps = ex->issued - ex->fuel;
+    h.depth = (uint32_t)ex->depth;
+    h.node_count = ast_count;
+    h.nmaps = ex->nmaps;
+    for (uint32_t id = 0; id < h.nvars; id++) {
+        declared[id] = (uint8_t)var_declared(ex, (int)id);
+        sym[id] = var_value(ex, (int)id);
+    }
+
+    snprintf(tmp, sizeof tmp, "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) { perror(tmp); return 0; }
+    int ok = fwrite(&h, sizeof h, 1, f) == 1
+          && fwrite(declared, 1, h.nvars, f) == h.nvars
+          && fwrite(sym, sizeof(int), h.nvars, f) == h.nvars
+          && fwrite(ex->stack, sizeof(NodeId), ex->depth, f) == ex->depth;
+    for (uint32_t i = 0; ok && i < h.nmaps; i++) {
+        const IntMap *m = ex->maps[i];
+        ok = fwrite(&m->size, sizeof m->size, 1, f) == 1;
+        for (uint32_t j = 0; ok && j < m->cap; j++)
+            if (m->ctrl[j] >= 0)
+                ok = fwrite(&m->keys[j], sizeof(int32_t), 1, f) == 1
+                  && fwrite(&m->vals[j], sizeof(int32_t), 1, f) == 1;
+    }
+    if (fclose(f) != 0) ok = 0;
+    remove(path);
+    if (!ok || rename(tmp, path) != 0) {
+        fprintf(stderr, "%s: write failed\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+/* cut an output file opened for update back to its length at the
+   checkpoint and continue writing at its end */
+static int restore_output(FILE *f, uint64_t offset) {
+    if (!f || f == stderr) return 1;
+    if (fseek(f, 0, SEEK_END) != 0 || (uint64_t)ftell(f) < offset) return 0;
+    fflush(f);
+    if (ftruncate(fileno(f), (off_t)offset) != 0) return 0;
+    return fseek(f, 0, SEEK_END) == 0;
+}
+
+/* load a checkpoint into ex, whose program has just been parsed */
+int exec_restore(Exec *ex, const char *path) {
+    CheckpointHeader h;
+    uint8_t declared[MAX_VARS];
+    int sym[MAX_VARS];
+    FILE *f = fopen(path, "rb");
+    if (!f) { perror(path); return 0; }
+    if (fread(&h, sizeof h, 1, f) != 1 || h.magic != CHECKPOINT_MAGIC || h.nvars > SHARED_BASE) {
+        fprintf(stderr, "%s: not a checkpoint file\n", path);
+        fclose(f);
+        return 0;
+    }
+    if (h.node_count != ast_count || h.ast_hash != ast_hash()) {
+        fprintf(stderr, "%s: checkpoint was taken from a different program\n", path);
+        fclose(f);
+        return 0;
+    }
+    ex->depth = 0;
+    int ok = fread(declared, 1, h.nvars, f) == h.nvars
+          && fread(sym, sizeof(int), h.nvars, f) == h.nvars;
+    for (uint32_t i = 0; ok && i < h.depth; i++) {
+        NodeId stmt;
+        ok = fread(&stmt, sizeof stmt, 1, f) == 1 && stmt && stmt < ast_count;
+        if (ok) exec_push(ex, stmt);
+    }
+    IntMap **maps = (IntMap**)calloc(h.nmaps ? h.nmaps : 1, sizeof(IntMap*));
+    if (!maps) { perror("calloc"); exit(1); }
+    for (uint32_t i = 0; ok && i < h.nmaps; i++) {
+        uint32_t size;
+        maps[i] = map_new();
+        ok = fread(&size, sizeof size, 1, f) == 1;
+        for (uint32_t j = 0; ok && j < size; j++) {
+            int32_t kv[2];
+            ok = fread(kv, sizeof(int32_t), 2, f) == 2 && map_put(maps[i], kv[0], kv[1], ex->mem);
+        }
+    }
+    fclose(f);
+    for (uint32_t id = 0; ok && id < h.nvars; id++)
+        if (declared[id] > VAR_MAP || (declared[id] == VAR_MAP && (uint32_t)sym[id] >= h.nmaps)) ok = 0;
+    if (!ok) {
+        for (uint32_t i = 0; i < h.nmaps; i++) map_release(maps[i]);
+        free(maps);
+        fprintf(stderr, "%s: truncated checkpoint file\n", path);
+        return 0;
+    }
+    ex->maps = maps;
+    ex->nmaps = ex->maps_cap = h.nmaps;
+    for (uint32_t id = 0; id < h.nvars; id++)
+        if (declared[id]) var_store(ex, (int)id, sym[id], declared[id]);
+    ex->issued = h.steps;
+    if (!restore_output(ex->out.file, h.out_offset) ||
+        !restore_output(ex->tree.file, h.tree_offset) ||
+        !restore_output(yyError, h.error_offset)) {
+        fprintf(stderr, "%s: out.txt, tree.txt or outError.txt does not match the checkpoint\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+/* ---- statement coverage ----
+   -coverage FILE counts how often every statement ran and which way every
+   if went. The counters are in one array indexed by NodeId (Exec.cov): a
+   statement counts in its own slot, an if counts the then branch in its
+   own slot and the else branch in the slot of its branches node, and a
+   while counts the tests after each pass in the slot of its N_LOOP node.
+   At exit the counters of the located statements are written in loc_table
+   order (two for an if), one byte each sticking at 255, after a header
+   carrying the AST hash as in a checkpoint. -coverage-report FILE parses
+   in.txt again and prints it with the counts, gcov style.
+   -profile FILE writes the same counters whole, four bytes each and two
+   for a while too, as a profile for -profile-use (see the optimizer). */
+#define COVERAGE_MAGIC 0x31564f43u  /* "COV1" */
+#define PROFILE_MAGIC 0x31465250u   /* "PRF1" */
+
+typedef struct CoverageHeader {
+    uint32_t magic;
+    uint32_t node_count;        /* ast_count */
+    uint64_t ast_hash;
+    uint32_t count;             /* counter bytes that follow */
+} CoverageHeader;
+
+/* the counters of the located statements: one per statement, then and
+   else for an if; out must hold 2 * loc_count bytes */
+static uint32_t coverage_pack(const uint32_t *cov, uint8_t *out) {
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < loc_count; i++) {
+        NodeId n = loc_table[i].node;
+        out[k++] = cov[n] < 255 ? (uint8_t)cov[n] : 255;
+        if (stmt_kind(n) == N_IF) out[k++] = cov[AST_RHS(n)] < 255 ? (uint8_t)cov[AST_RHS(n)] : 255;
+    }
+    return k;
+}
+
+/* the second counter of a statement in a profile, or 0 if it has one */
+static NodeId profile_second(NodeId n) {
+    switch (stmt_kind(n)) {
+        case N_IF: return AST_RHS(n);
+        case N_WHILE: return (NodeId)AST_VALUE(n);
+    }
+    return 0;
+}
+
+int profile_save(const uint32_t *cov, const char *path) {
+    CoverageHeader h;
+    uint32_t *counts = (uint32_t*)malloc((2 * (size_t)loc_count + 1) * sizeof(uint32_t));
+    if (!counts) { perror("malloc"); exit(1); }
+    memset(&h, 0, sizeof h);
+    h.magic = PROFILE_MAGIC;
+    h.node_count = ast_count;
+    h.ast_hash = ast_hash();
+    for (uint32_t i = 0; i < loc_count; i++) {
+        NodeId n = loc_table[i].node, second = profile_second(n);
+        counts[h.count++] = cov[n];
+        if (second) counts[h.count++] = cov[second];
+    }
+    FILE *f = fopen(path, "wb");
+    if (!f) { perror(path); free(counts); return 0; }
+    int ok = fwrite(&h, sizeof h, 1, f) == 1 && fwrite(counts, sizeof(uint32_t), h.count, f) == h.count;
+    if (fclose(f) != 0) ok = 0;
+    free(counts);
+    if (!ok) fprintf(stderr, "%s: write failed\n", path);
+    return ok;
+}
+
+/* load a profile of the program just parsed into profile[] */
+int profile_load(const char *path) {
+    CoverageHeader h;
+    FILE *f = fopen(path, "rb");
+    if (!f) { perror(path); return 0; }
+    if (fread(&h, sizeof h, 1, f) != 1 || h.magic != PROFILE_MAGIC) {
+        fprintf(stderr, "%s: not a profile\n", path);
+        fclose(f);
+        return 0;
+    }
+    if (h.node_count != ast_count || h.ast_hash != ast_hash() || h.count > 2 * loc_count) {
+        fprintf(stderr, "%s: the profile was recorded for a different program\n", path);
+        fclose(f);
+        return 0;
+    }
+    uint32_t *counts = (uint32_t*)malloc((h.count + 1) * sizeof(uint32_t));
+    profile = (uint32_t*)calloc(ast_count, sizeof(uint32_t));
+    if (!counts || !profile) { perror("malloc"); exit(1); }
+    int ok = fread(counts, sizeof(uint32_t), h.count, f) == h.count;
+    fclose(f);
+    for (uint32_t i = 0, k = 0; ok && i < loc_count; i++) {
+        NodeId n = loc_table[i].node, second = profile_second(n);
+        if (k + 1 + (second != 0) > h.count) ok = 0;
+        else {
+            profile[n] = counts[k++];
+            if (second) profile[second] = counts[k++];
+        }
+    }
+    free(counts);
+    if (!ok) {
+        fprintf(stderr, "%s: truncated profile\n", path);
+        free(profile);
+        profile = NULL;
+        return 0;
+    }
+    profile_nodes = ast_count;
+    return 1;
+}
+
+int coverage_save(const uint32_t *cov, const char *path) {
+    CoverageHeader h;
+    uint8_t *counts = (uint8_t*)malloc(2 * (size_t)loc_count + 1);
+    if (!counts) { perror("malloc"); exit(1); }
+    memset(&h, 0, sizeof h);
+    h.magic = COVERAGE_MAGIC;
+    h.node_count = ast_count;
+    h.ast_hash = ast_hash();
+    h.count = coverage_pack(cov, counts);
+    FILE *f = fopen(path, "wb");
+    if (!f) { perror(path); free(counts); return 0; }
+    int ok = fwrite(&h, sizeof h, 1, f) == 1 && fwrite(counts, 1, h.count, f) == h.count;
+    if (fclose(f) != 0) ok = 0;
+    free(counts);
+    if (!ok) fprintf(stderr, "%s: write failed\n", path);
+    return ok;
+}
+
+static void coverage_count(FILE *out, int count) {
+    if (count == 0) fprintf(out, "%9s:", "#####");
+    else if (count >= 255) fprintf(out, "%9s:", "255+");
+    else fprintf(out, "%9d:", count);
+}
+
+/* print in.txt (src, just parsed) with the counts saved in path */
+int coverage_report(const char *path, FILE *src, FILE *out) {
+    CoverageHeader h;
+    FILE *f = fopen(path, "rb");
+    if (!f) { perror(path); return 0; }
+    if (fread(&h, sizeof h, 1, f) != 1 || h.magic != COVERAGE_MAGIC) {
+        fprintf(stderr, "%s: not a coverage file\n", path);
+        fclose(f);
+        return 0;
+    }
+    if (h.node_count != ast_count || h.ast_hash != ast_hash() || h.count > 2 * loc_count) {
+        fprintf(stderr, "%s: coverage was recorded for a different program\n", path);
+        fclose(f);
+        return 0;
+    }
+    uint8_t *counts = (uint8_t*)malloc(h.count + 1);
+    if (!counts) { perror("malloc"); exit(1); }
+    int ok = fread(counts, 1, h.count, f) == h.count;
+    fclose(f);
+    if (!ok) { fprintf(stderr, "%s: truncated coverage file\n", path); free(counts); return 0; }
+
+    /* statements are in source order, so one pass over the lines suffices;
+       lines end at '\n' only, as for the scanner's line table */
+    uint32_t i = 0, k = 0, stmts = 0, stmts_run = 0, branches = 0, branches_taken = 0;
+    size_t size, pos = 0;
+    rewind(src);
+    unsigned char *text = read_input(src, &size);
+    for (int line = 1; pos < size; line++) {
+        const unsigned char *start = text + pos, *nl = memchr(start, '\n', size - pos);
+        size_t len = nl ? (size_t)(nl - start) : size - pos;
+        pos += len + (nl != NULL);
+        while (len && start[len - 1] == '\r') len--;
+        int first = -1, then_count = -1, else_count = 0, l, c;
+        while (i < loc_count && (offset_to_line_col(loc_table[i].offset, &l, &c), l == line)) {
+            int run = counts[k], is_if = stmt_kind(loc_table[i].node) == N_IF;
+            if (is_if) {
+                then_count = counts[k];
+                else_count = counts[k + 1];
+                run = then_count + else_count;
+                branches += 2;
+                branches_taken += (then_count != 0) + (else_count != 0);
+            }
+            if (first < 0) first = run;
+            stmts++;
+            stmts_run += run != 0;
+            k += 1 + is_if;
+            i++;
+        }
+        if (first < 0) fprintf(out, "%9s:", "-");
+        else coverage_count(out, first);
+        fprintf(out, "%5d:%.*s\n", line, (int)len, (const char*)start);
+        if (then_count >= 0) {
+            fprintf(out, "branch then taken %d%s\n", then_count, then_count >= 255 ? "+" : "");
+            fprintf(out, "branch else taken %d%s\n", else_count, else_count >= 255 ? "+" : "");
+        }
+    }
+    fprintf(out, "statements run: %u of %u (%.1f%%)\n", stmts_run, stmts,
+            stmts ? 100.0 * stmts_run / stmts : 100.0);
+    fprintf(out, "branches taken: %u of %u (%.1f%%)\n", branches_taken, branches,
+            branches ? 100.0 * branches_taken / branches : 100.0);
+    free(text);
+    free(counts);
+    return 1;
+}
+
+/* ---- metrics (-metrics) ----
+   Counters, gauges and latency histograms for a long-running compiler
+   (-serve), scraped over HTTP in the Prometheus text format. Each thread
+   records into its own shard (the main thread into shard 0, -batch worker i
+   into shard 1 + i % (METRIC_SHARDS - 1)) with a relaxed load and store,
+   which is neither a lock nor a locked instruction; a scrape sums the shards.
+   Workers past METRIC_SHARDS - 1 share a shard and may lose an update.
+   Recording is per program (a parse, a run), never per statement.
+   Histograms are HDR-style: 2^HIST_SUB_BITS buckets per power of two of
+   nanoseconds, so a bucket is within 1/8 of its value at any scale. */
+enum { M_PROGRAMS, M_STATEMENTS, M_ERRORS, M_MODULE_HITS, M_MODULE_COMPILES, M_COUNTERS };
+enum { G_AST_NODES, G_AST_ARENA_BYTES, G_HASHCONS_BYTES, G_LOC_BYTES, M_GAUGES };
+enum { H_LEX, H_PARSE, H_EXECUTE, M_HISTS };
+
+#define HIST_SUB_BITS 3
+#define HIST_MIN_SHIFT 10       /* below 2^10 ns (~1 us): bucket 0 */
+#define HIST_OCTAVES 28         /* up to 2^38 ns (~275 s); above: the last bucket */
+#define HIST_BUCKETS (2 + (HIST_OCTAVES << HIST_SUB_BITS))
+#define METRIC_SHARDS 64
+
+typedef struct MetricShard {
+    _Atomic uint64_t counter[M_COUNTERS];
+    _Atomic uint64_t bucket[M_HISTS][HIST_BUCKETS];
+    _Atomic uint64_t sum_ns[M_HISTS];
+    char pad[CACHE_LINE];       /* keep neighbouring shards off each other's lines */
+} MetricShard;
+
+MetricShard *metric_shards = NULL;      /* NULL while -metrics is off */
+_Atomic uint64_t metric_gauge[M_GAUGES];
+_Thread_local unsigned metric_slot = 0;
+
+static unsigned hist_bucket(uint64_t ns) {
+    if (ns < (1ull << HIST_MIN_SHIFT)) return 0;
+    unsigned e = 63 - (unsigned)__builtin_clzll(ns);     /* ns in [2^e, 2^(e+1)) */
+    if (e >= HIST_MIN_SHIFT + HIST_OCTAVES) return HIST_BUCKETS - 1;
+    unsigned sub = (unsigned)(ns >> (e - HIST_SUB_BITS)) & ((1u << HIST_SUB_BITS) - 1);
+    return 1 + ((e - HIST_MIN_SHIFT) << HIST_SUB_BITS) + sub;
+}
+
+/* single writer per shard: no read-modify-write needed */
+static inline void metric_bump(_Atomic uint64_t *c, uint64_t n) {
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n,
+                          memory_order_relaxed);
+}
+
+void metric_add(int counter, uint64_t n) {
+    if (metric_shards) metric_bump(&metric_shards[metric_slot].counter[counter], n);
+}
+
+void metric_time(int hist, double seconds) {
+    if (!metric_shards) return;
+    uint64_t ns = seconds > 0 ? (uint64_t)(seconds * 1e9) : 0;
+    MetricShard *s = &metric_shards[metric_slot];
+    metric_bump(&s->bucket[hist][hist_bucket(ns)], 1);
+    metric_bump(&s->sum_ns[hist], ns);
+}
+
+/* the memory gauges, set by the main thread after each parse */
+void metric_arena(void) {
+    if (!metric_shards) return;
+    unsigned chunks = 0;
+    while (chunks < AST_MAX_CHUNKS && ast_chunks[chunks]) chunks++;
+    atomic_store_explicit(&metric_gauge[G_AST_NODES], ast_count - 1, memory_order_relaxed);
+    atomic_store_explicit(&metric_gauge[G_AST_ARENA_BYTES], (uint64_t)chunks * sizeof(AstChunk),
+                          memory_order_relaxed);
+    atomic_store_explicit(&metric_gauge[G_HASHCONS_BYTES], (uint64_t)hc_cap * sizeof(NodeId),
+                          memory_order_relaxed);
+    atomic_store_explicit(&metric_gauge[G_LOC_BYTES],
+                          (uint64_t)loc_cap * sizeof(LocEntry) + (uint64_t)use_cap * sizeof(UseEntry),
+                          memory_order_relaxed);
+}
+
+/* ---- error reporting ----
+   Errors are printed to outError.txt as they happen. While the -pipeline
+   threads run, each thread collects its errors in pending_errors instead and
+   they are printed after the threads join: locating an error reads the
+   scanner's line table and loc_table, which the other threads are still
+   growing. Messages are string literals, so only the pointer is kept. */
+typedef struct PendingError {
+    const char *msg;
+    uint32_t offset;    /* source offset, for lexer/parser errors */
+    NodeId stmt;        /* failing statement, for runtime errors (0 if none) */
+    NodeId use;         /* the expression in it that failed (0: the statement) */
+} PendingError;
+
+typedef struct ErrorList {
+    PendingError *items;
+    size_t count, cap;
+} ErrorList;
+
+_Thread_local ErrorList *pending_errors = NULL;
+
+static void error_list_add(ErrorList *list, const char *msg, uint32_t offset, NodeId stmt, NodeId use) {
+    if (list->count == list->cap) {
+        list->cap = list->cap ? list->cap * 2 : 16;
+        list->items = (PendingError*)realloc(list->items, list->cap * sizeof(PendingError));
+        if (!list->items) { perror("realloc"); exit(1); }
+    }
+    list->items[list->count].msg = msg;
+    list->items[list->count].offset = offset;
+    list->items[list->count].stmt = stmt;
+    list->items[list->count].use = use;
+    list->count++;
+}
+
+/* ---- collected diagnostics (-diagnostics) ----
+   By default an error is printed when it is reported. With -diagnostics
+   text|jsonl errors are collected instead: each distinct error (message
+   and position) is kept once, with a code and the number of times it
+   happened, up to diag_max of them (-max-errors), and the list is written
+   when the program finishes (diag_flush). A statement that fails on every
+   pass of a loop gives one line. Errors are only printed on the main
+   thread (other threads hold theirs in pending_errors), so the table
+   needs no lock. */
+enum { DIAG_OFF, DIAG_TEXT, DIAG_JSONL };
+
+typedef struct Diag {
+    const char *msg;        /* literal, or owned by the module table */
+    int line, col;
+    unsigned long count;
+} Diag;
+
+int diag_format = DIAG_OFF;
+uint32_t diag_max = 100;
+static Diag *diags = NULL;
+static uint32_t diag_count = 0;
+static uint32_t *diag_index = NULL;     /* diags index + 1; 0 = empty slot */
+static uint32_t diag_index_cap = 0;     /* power of two, at least twice diag_max */
+static unsigned long diag_dropped = 0;  /* errors past diag_max distinct ones */
+
+/* codes by message; messages not listed (module errors) get E100 */
+static const struct { const char *code, *msg; } diag_codes[] = {
+    { "E101", "invalid character" },
+    { "E102", "syntax error" },
+    { "E103", "Map is full" },
+    { "E201", "Use of undeclared variable" },
+    { "E202", "Assignment to undeclared variable" },
+    { "E203", "Division by zero" },
+    { "E204", "Map used as a value" },
+    { "E205", "Key not found in map" },
+    { "E206", "Indexing a variable that is not a map" },
+    { "E207", "Assignment to a map variable" },
+    { "E208", "A shared variable cannot be a map" },
+    { "E209", "Declaration left side is not a variable" },
+    { "E210", "Assignment left side is not a variable" },
+    { "E301", "Statement budget exceeded" },
+    { "E302", "Deadline exceeded" },
+    { "E303", "Memory limit exceeded" },
+    { "E901", "If branches malformed" },
+    { "E902", "Unknown operator in eval_expr" },
+    { "E903", "eval_expr: expected expression node" },
+    { "E904", "Unknown statement kind in execute_stmt" },
+};
+
+static const char *diag_code(const char *msg) {
+    for (size_t i = 0; i < sizeof diag_codes / sizeof diag_codes[0]; i++)
+        if (strcmp(diag_codes[i].msg, msg) == 0) return diag_codes[i].code;
+    return "E100";
+}
+
+static uint32_t diag_hash(const char *msg, int line, int col) {
+    uint32_t h = 2166136261u;
+    for (const char *c = msg; *c; c++) h = (h ^ (uint8_t)*c) * 16777619u;
+    h = (h ^ (uint32_t)line) * 16777619u;
+    h = (h ^ (uint32_t)col) * 16777619u;
+    return h ^ (h >> 15);
+}
+
+static void diag_add(const char *msg, int line, int col) {
+    if (!diag_index) {
+        diag_index_cap = 16;
+        while (diag_index_cap < 2 * (diag_max + 1)) diag_index_cap *= 2;
+        diag_index = (uint32_t*)calloc(diag_index_cap, sizeof(uint32_t));
+        diags = (Diag*)malloc((diag_max + 1) * sizeof(Diag));
+        if (!diag_index || !diags) { perror("malloc"); exit(1); }
+    }
+    uint32_t i = diag_hash(msg, line, col) & (diag_index_cap - 1);
+    for (uint32_t k; (k = diag_index[i]) != 0; i = (i + 1) & (diag_index_cap - 1)) {
+        Diag *d = &diags[k - 1];
+        if (d->line == line && d->col == col && strcmp(d->msg, msg) == 0) {
+            d->count++;
+            return;
+        }
+    }
+    if (diag_count == diag_max) {
+        diag_dropped++;
+        return;
+    }
+    diags[diag_count] = (Diag){ msg, line, col, 1 };
+    diag_index[i] = ++diag_count;
+}
+
+static void json_string(FILE *f, const char *s) {
+    putc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fprintf(f, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20) fprintf(f, "\\u%04x", (unsigned char)*s);
+        else putc(*s, f);
+    }
+    putc('"', f);
+}
+
+/* write the collected errors to f, in the order they first happened,
+   and start a new list */
+void diag_flush(FILE *f) {
+    if (!f) f = stderr;
+    for (uint32_t i = 0; i < diag_count; i++) {
+        const Diag *d = &diags[i];
+        if (diag_format == DIAG_JSONL) {
+            fprintf(f, "{\"code\":\"%s\",\"severity\":\"error\",\"message\":", diag_code(d->msg));
+            json_string(f, d->msg);
+            fprintf(f, ",\"line\":%d,\"column\":%d,\"count\":%lu}\n", d->line, d->col, d->count);
+        } else if (d->count > 1) {
+            fprintf(f, "Error: %s at line %d, column %d (%lu times)\n", d->msg, d->line, d->col, d->count);
+        } else {
+            fprintf(f, "Error: %s at line %d, column %d\n", d->msg, d->line, d->col);
+        }
+    }
+    if (diag_dropped) {
+        if (diag_format == DIAG_JSONL)
+            fprintf(f, "{\"severity\":\"note\",\"message\":\"errors past -max-errors %u\",\"count\":%lu}\n",
+                    (unsigned)diag_max, diag_dropped);
+        else
+            fprintf(f, "Note: %lu more errors past -max-errors %u were not recorded\n", diag_dropped, (unsigned)diag_max);
+    }
+    if (diag_index) memset(diag_index, 0, diag_index_cap * sizeof(uint32_t));
+    diag_count = 0;
+    diag_dropped = 0;
+}
+
+static void print_error(const char *msg, uint32_t offset) {
+    int line, col;
+    if (!yyError) yyError = stderr;
+    offset_to_line_col(offset, &line, &col);
+    metric_add(M_ERRORS, 1);
+    if (diag_format != DIAG_OFF) diag_add(msg, line, col);
+    else fprintf(yyError, "Error: %s at line %d, column %d\n", msg, line, col);
+}
+
+/* lexical and syntax errors, located at a source offset */
+void error_at(const char *msg, uint32_t offset)
+{
+    if (pending_errors) error_list_add(pending_errors, msg, offset, 0, 0);
+    else print_error(msg, offset);
+}
+
+/* source offset of a runtime error: the failing use in stmt if it was
+   recorded, else the start of stmt (the test of a while again is its own) */
+static uint32_t runtime_error_offset(NodeId stmt, NodeId use) {
+    if (stmt && stmt_kind(stmt) == N_LOOP) stmt = AST_LHS(stmt);
+    uint32_t offset = use_offset(stmt, use);
+    return offset ? offset : node_offset(stmt);
+}
+
+/* runtime errors, located at the expression that failed in stmt (use) or
+   at the start of stmt */
+void semantic_error_at(const char *msg, NodeId stmt, NodeId use)
+{
+    if (pending_errors) error_list_add(pending_errors, msg, 0, stmt, use);
+    else print_error(msg, runtime_error_offset(stmt, use));
+}
+
+void semantic_error(const char *msg, NodeId stmt)
+{
+    semantic_error_at(msg, stmt, 0);
+}
+
+/* print the errors held back while the lexer ran ahead of the parser:
+   lexer and parser errors interleaved by position, as a sequential run
+   reports them. A sequential run stops lexing at a syntax error, so lexer
+   errors past it are dropped. Both lists are emptied. */
+void flush_front_end_errors(ErrorList *lex, ErrorList *parse)
+{
+    size_t i = 0, j = 0;
+    if (parse->count) {
+        uint32_t stop = parse->items[parse->count - 1].offset;
+        while (lex->count && lex->items[lex->count - 1].offset > stop)
+            lex->count--;
+    }
+    while (i < lex->count || j < parse->count) {
+        PendingError *e;
+        if (j == parse->count ||
+            (i < lex->count && lex->items[i].offset <= parse->items[j].offset))
+            e = &lex->items[i++];
+        else
+            e = &parse->items[j++];
+        print_error(e->msg, e->offset);
+    }
+    free(lex->items);
+    free(parse->items);
+    memset(lex, 0, sizeof *lex);
+    memset(parse, 0, sizeof *parse);
+}
+
+}
+
+/* Types shared with the scanner through parser.tab.h (the %code block above
+   is emitted after them, so it can use them too). Locations are byte
+   offsets into the source (set by the scanner in YY_USER_ACTION); lines and
+   columns are computed from them on demand. */
+%code requires {
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t NodeId;   /* index of an AST node; 0 is the null node */
+
+/* Operator codes: the value of OP tokens and the op[] of N_OP nodes */
+enum {
+    OP_NONE = 0,
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV,
+    OP_EQ, OP_NE, OP_LE, OP_GE, OP_LT, OP_GT
+};
+
+/* memory charged to one program (see mem_charge() in parser.y) */
+typedef struct MemLimit {
+    _Atomic size_t used;    /* bytes charged so far */
+    size_t limit;           /* 0: no limit */
+    _Atomic int exceeded;   /* a charge was refused */
+} MemLimit;
+
+/* packed token, as stored by -tokens and carried by the -pipeline queue */
+typedef struct Token {
+    int32_t value;      /* INTEGER value, VARIABLE id, OP code or STRING module; 0 otherwise */
+    uint32_t offset;    /* byte offset of the first character */
+    uint16_t kind;      /* token number (0 = end of input) */
+    uint16_t length;    /* length in bytes */
+} Token;
+
+typedef struct YYLTYPE {
+    uint32_t first;     /* offset of the first byte */
+    uint32_t last;      /* offset one past the last byte */
+} YYLTYPE;
+#define YYLTYPE_IS_DECLARED 1
+
+#define YYLLOC_DEFAULT(Cur, Rhs, N)                                  \
+    do {                                                             \
+        if (N) {                                                     \
+            (Cur).first = YYRHSLOC(Rhs, 1).first;                    \
+            (Cur).last  = YYRHSLOC(Rhs, N).last;                     \
+        } else {                                                     \
+            (Cur).first = (Cur).last = YYRHSLOC(Rhs, 0).last;        \
+        }                                                            \
+    } while (0)
+}
+
+%locations
+
+/* Bison declarations */
+%union {
+    int ival;
+    float fval;
+    char* sval;
+    NodeId node;
+}
+
+/* tokens */
+%token<ival> INTEGER
+%token<ival> VARIABLE
+%token PRINT
+%token IF
+%token ELSE
+%token INT
+%token END
+%token MAP
+%token DELETE
+%token WHILE
+%token IMPORT
+%token<ival> STRING   /* file name of an import: module index, see module_import() */
+%token<ival> OP   /* operator code (OP_EQ ...) */
+
+/* nonterminals that carry Node* */
+%type<node> program topStmts stmts stmt declaration assignment printStatement IfStatement ifHead block condition expr
+%type<node> WhileStatement whileHead importStatement
+%type<node> mapDeclaration mapAssignment mapDelete
+
+/* precedence & dangling-else */
+%nonassoc LOWER_ELSE
+%right '='
+%left '+' '-'
+%left '*' '/'
+
+%%
+
+program:
+      topStmts
+      {
+          /* top-level statements are executed by main() once parsing succeeds */
+          program_root = $1;
+      }
+    ;
+
+/* topStmts: the top-level stmt-list. With -pipeline each statement is handed
+   to the executor as soon as it is parsed and no list is built. */
+topStmts:
+      /* empty */   { $$ = 0; }
+    | topStmts stmt {
+                        if (pipe_state) {
+                            pipeline_emit($2);
+                            $$ = 0;
+                        } else {
+                            $$ = append_stmt($1, $2);
+                        }
+                    }
+    ;
+
+/* stmts forms a stmt-list (or NULL) */
+stmts:
+      /* empty */   { $$ = 0; }
+    | stmts stmt    {
+                        /* append stmt to list (a single stmt is still wrapped into a stmtlist node to be uniform);
+                           an import appends the statements of its module */
+                        $$ = append_stmt($1, $2);
+                    }
+    ;
+
+/* a statement returns a NodeId (no execution here) */
+stmt:
+      declaration  { $$ = $1; }
+    | assignment   { $$ = $1; }
+    | printStatement { $$ = $1; }
+    | IfStatement  { $$ = $1; }
+    | WhileStatement { $$ = $1; }
+    | mapDeclaration { $$ = $1; }
+    | mapAssignment  { $$ = $1; }
+    | mapDelete      { $$ = $1; }
+    | importStatement { $$ = $1; }
+    | expr ';'     { /* expression statement: evaluate at execution time; wrap as a print of value? we keep it as an expr node to be executed as printing its value */
+                      /* We'll wrap it in a print-like node to keep execution consistent: a "printexpr" -> we'll use N_PRINT with left = expr */
+                      $$ = loc_record(new_print_node($1), @$.first);
+                    }
+    ;
+
+/* declaration: INT VARIABLE '=' expr ';' */
+declaration:
+      INT VARIABLE '=' expr ';'
+      {
+          /* var node with id */
+          NodeId varNode = new_var_node($2);
+          NodeId dec = new_decl_node(varNode, $4);
+          $$ = loc_record(dec, @$.first);
+      }
+    ;
+
+/* assignment: VARIABLE '=' expr ';' */
+assignment:
+      VARIABLE '=' expr ';'
+      {
+          NodeId varNode = new_var_node($1);
+          NodeId asn = new_assign_node(varNode, $3);
+          $$ = loc_record(asn, @$.first);
+      }
+    ;
+
+/* mapDeclaration: MAP VARIABLE ';' (a new, empty map) */
+mapDeclaration:
+      MAP VARIABLE ';'
+      {
+          $$ = loc_record(new_map_decl_node(new_var_node($2)), @$.first);
+      }
+    ;
+
+/* mapAssignment: VARIABLE '[' expr ']' '=' expr ';' (insert or replace) */
+mapAssignment:
+      VARIABLE '[' expr ']' '=' expr ';'
+      {
+          NodeId index = use_record(new_index_node(new_var_node($1), $3), @1.first);
+          $$ = loc_record(new_map_set_node(index, $6), @$.first);
+      }
+    ;
+
+/* mapDelete: DELETE VARIABLE '[' expr ']' ';' */
+mapDelete:
+      DELETE VARIABLE '[' expr ']' ';'
+      {
+          NodeId index = use_record(new_index_node(new_var_node($2), $4), @2.first);
+          $$ = loc_record(new_map_delete_node(index), @$.first);
+      }
+    ;
+
+/* importStatement: IMPORT STRING ';' (the module was loaded before
+   parsing; a module that cannot be imported ends the parse) */
+importStatement:
+      IMPORT STRING ';'
+      {
+          $$ = new_import_node($2, @$.first);
+          if (!$$) YYABORT;
+      }
+    ;
+
+/* printStatement: PRINT '(' expr ')' ';' */
+printStatement:
+      PRINT '(' expr ')' ';'
+      {
+          NodeId p = new_print_node($3);
+          $$ = loc_record(p, @$.first);
+      }
+    ;
 
 /* If with and without else: build if node (no execution here) */
 IfStatement:
-    IF '(' condition ')' ':' block ELSE ':' block END
+    ifHead ':' block ELSE ':' block END
       {
-          Node *ifn = new_if_node($3, $6, $9);
+          NodeId ifn = finish_if_node($1, $3, $6);
           $$ = ifn;
       }
-    | IF '(' condition ')' ':' block %prec LOWER_ELSE END
+    | ifHead ':' block %prec LOWER_ELSE END
       {
-          Node *ifn = new_if_node($3, $6, NULL);
+          NodeId ifn = finish_if_node($1, $3, 0);
           $$ = ifn;
       }
     ;
 
-/* block yields the stmtlist (or NULL) */
-block:
-      stmts
-      {
-          $$ = $1;  /* block is simply the stmtlist produced */
-      }
-    ;
+/* ifHead: the if node is created (and located) before its blocks are parsed */
+ifHead:
+    IF '(' condition ')'
+      {
+          $$ = loc_record(new_if_node($3), @$.first);
+      }
+    ;
+
+/* while loop: the body runs as long as the condition holds */
+WhileStatement:
+    whileHead ':' block END
+      {
+          $$ = finish_while_node($1, $3);
+      }
+    ;
+
+/* whileHead: created (and located) before the body, like ifHead */
+whileHead:
+    WHILE '(' condition ')'
+      {
+          $$ = loc_record(new_while_node($3), @$.first);
+      }
+    ;
+
+/* block yields the stmtlist (or NULL) */
+block:
+      stmts
+      {
+          $$ = $1;  /* block is simply the stmtlist produced */
+      }
+    ;
+
+/* condition: produce expression-op node (left op right) */
+condition:
+      expr OP expr
+      {
+          /* OP is an operator code (the lexer maps the string) */
+          $$ = new_op_node($2, $1, $3);
+          /* We do not evaluate now; evaluation happens at run-time via eval_expr */
+      }
+    ;
+
+/* arithmetic expressions: build expression tree (no runtime evaluation now);
+   the expressions that can fail at run time note where they are used */
+expr:
+      INTEGER
+      {
+          $$ = new_int_node($1);
+      }
+    | VARIABLE
+      {
+          $$ = use_record(new_var_node($1), @1.first);
+      }
+    | VARIABLE '[' expr ']'
+      {
+          /* map lookup */
+          $$ = use_record(new_index_node(new_var_node($1), $3), @1.first);
+      }
+    | expr '+' expr
+      {
+          $$ = new_op_node(OP_ADD, $1, $3);
+      }
+    | expr '-' expr
+      {
+          $$ = new_op_node(OP_SUB, $1, $3);
+      }
+    | expr '*' expr
+      {
+          $$ = new_op_node(OP_MUL, $1, $3);
+      }
+    | expr '/' expr
+      {
+          $$ = use_record(new_op_node(OP_DIV, $1, $3), @2.first);
+      }
+    | '(' expr ')'
+      {
+          $$ = $2;
+      }
+    ;
+
+%%
+
+/* error reporting */
+void yyerror(char *s) {
+    error_at(s, yylloc.first);
+}
+
+/* packed token stream, scanner.l */
+Token lex_token(void);
+int token_apply(const Token *t);
+extern int (*token_source)(void);
+void tokens_lex_all(void);
+void tokens_lex_fast(void);
+void tokens_benchmark(FILE *out);
+void tokens_find_imports(const unsigned char *buf, size_t len,
+                         void (*found)(const char *spec, size_t len));
+int tokens_save(const char *path);
+int tokens_load(const char *path);
+void scanner_reset(FILE *f, int keep_vars);
+void scanner_save_vars(void);
+uint32_t *scanner_take_lines(int *count);
+extern uint32_t tok_count;
+extern uint32_t src_offset;
+extern uint32_t *line_starts;
+extern int line_count;
+
+/* wall-clock time in seconds, for -time */
+double now_seconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* ---- record and replay (-record, -replay) ----
+   -record FILE logs everything a run depends on besides the compiler: the
+   text of in.txt and of every module it imports, with what each import
+   resolved to; the engine (-tokens, -fast-lex, -pipeline, -speculate); -O
+   and -unroll; the limits; and the -shared and -diagnostics settings. The
+   language has no input statements, so that text is all the input there
+   is. A deadline cannot be repeated, so the log also keeps where the run
+   stopped: -replay FILE turns a recorded deadline into a statement budget
+   that runs out at the same statement. A replay reads nothing but the log
+   and writes the same out.txt, tree.txt and outError.txt.
+   The inputs are written before the program runs and the outcome is
+   patched into the header when it ends, so a run that never ends still
+   leaves a log to replay (without its deadline). */
+#define RECORD_MAGIC 0x43455243u        /* "CREC" */
+#define RECORD_VERSION 1u
+
+enum { RECORD_OFF, RECORD_ON, RECORD_REPLAY };
+enum { ENGINE_SEQUENTIAL, ENGINE_TOKENS, ENGINE_FAST_LEX, ENGINE_PIPELINE, ENGINE_SPECULATE };
+enum { STOP_UNKNOWN, STOP_END, STOP_DEADLINE };
+
+/* file: header, then length-prefixed blobs: the -shared arguments, each
+   resolution (dir, spec, path; an empty path: no such file), each module
+   (path, text), and in.txt */
+typedef struct RecordHeader {
+    uint32_t magic, version;
+    uint8_t engine, optimize, diag_format, stop;    /* stop: patched when the run ends */
+    uint32_t unroll, spec_threads, diag_max;
+    uint64_t spec_block, max_steps, max_memory;
+    double deadline;            /* seconds (0: none); a replay uses steps instead */
+    uint64_t steps;             /* statements run; with STOP_DEADLINE the replay's budget */
+    uint32_t nshared, nresolved, nsources;
+} RecordHeader;
+
+typedef struct Resolution {
+    char *dir, *spec, *path;    /* path NULL: no such file */
+} Resolution;
+
+typedef struct Source {
+    char *path;
+    unsigned char *text;
+    size_t len;
+} Source;
+
+int record_mode = RECORD_OFF;
+static RecordHeader rec;
+static Resolution *rec_resolved = NULL;
+static Source *rec_sources = NULL;
+static char **rec_shared = NULL;
+static Source rec_program;      /* in.txt */
+static FILE *rec_file = NULL;
+double record_seconds = 0;      /* spent writing the log (-time) */
+long record_bytes = 0;
+
+static char *blob_copy(const void *p, size_t n) {
+    char *c = (char*)malloc(n + 1);
+    if (!c) { perror("malloc"); exit(1); }
+    memcpy(c, p, n);
+    c[n] = '\0';
+    return c;
+}
+
+/* -shared argument, kept as given */
+void record_shared(char *spec) {
+    rec_shared = (char**)realloc(rec_shared, (rec.nshared + 1) * sizeof(char*));
+    if (!rec_shared) { perror("realloc"); exit(1); }
+    rec_shared[rec.nshared++] = spec;
+}
+
+/* what spec (relative to dir) resolved to while recording */
+void record_resolution(const char *dir, const char *spec, size_t len, const char *path) {
+    for (uint32_t i = 0; i < rec.nresolved; i++)
+        if (strcmp(rec_resolved[i].dir, dir) == 0 && strlen(rec_resolved[i].spec) == len &&
+            memcmp(rec_resolved[i].spec, spec, len) == 0) return;
+    rec_resolved = (Resolution*)realloc(rec_resolved, (rec.nresolved + 1) * sizeof(Resolution));
+    if (!rec_resolved) { perror("realloc"); exit(1); }
+    Resolution *r = &rec_resolved[rec.nresolved++];
+    r->dir = blob_copy(dir, strlen(dir));
+    r->spec = blob_copy(spec, len);
+    r->path = path ? blob_copy(path, strlen(path)) : NULL;
+}
+
+/* the text of the module at path, while recording */
+void record_source(const char *path, const unsigned char *text, size_t len) {
+    rec_sources = (Source*)realloc(rec_sources, (rec.nsources + 1) * sizeof(Source));
+    if (!rec_sources) { perror("realloc"); exit(1); }
+    Source *s = &rec_sources[rec.nsources++];
+    s->path = blob_copy(path, strlen(path));
+    s->text = (unsigned char*)blob_copy(text, len);
+    s->len = len;
+}
+
+/* the recorded resolution of spec (relative to dir), as module_resolve
+   returns it */
+char *replay_resolve(const char *dir, const char *spec, size_t len) {
+    for (uint32_t i = 0; i < rec.nresolved; i++)
+        if (strcmp(rec_resolved[i].dir, dir) == 0 && strlen(rec_resolved[i].spec) == len &&
+            memcmp(rec_resolved[i].spec, spec, len) == 0)
+            return rec_resolved[i].path ? blob_copy(rec_resolved[i].path, strlen(rec_resolved[i].path)) : NULL;
+    return NULL;
+}
+
+static FILE *memory_file(const Source *s) {
+#ifdef _WIN32
+    /* no fmemopen(): go through a temporary file */
+    FILE *f = tmpfile();
+    if (f && (fwrite(s->text, 1, s->len, f) != s->len || fseek(f, 0, SEEK_SET) != 0)) {
+        fclose(f);
+        f = NULL;
+    }
+    if (!f) perror("tmpfile");
+#else
+    /* fmemopen() cannot open an empty buffer */
+    FILE *f = s->len ? fmemopen(s->text, s->len, "rb") : tmpfile();
+    if (!f) perror("fmemopen");
+#endif
+    return f;
+}
+
+/* the recorded text of the module at path, as a stream */
+FILE *replay_open(const char *path) {
+    for (uint32_t i = 0; i < rec.nsources; i++)
+        if (strcmp(rec_sources[i].path, path) == 0) return memory_file(&rec_sources[i]);
+    return NULL;
+}
+
+static int write_blob(FILE *f, const void *p, uint64_t len) {
+    return fwrite(&len, sizeof len, 1, f) == 1 && fwrite(p, 1, len, f) == len;
+}
+
+static int write_string(FILE *f, const char *s) {
+    return write_blob(f, s ? s : "", s ? strlen(s) : 0);
+}
+
+/* NULL if it cannot be read, or is empty and allow_empty is 0 */
+static char *read_blob(FILE *f, size_t *len, int allow_empty) {
+    uint64_t n;
+    if (fread(&n, sizeof n, 1, f) != 1 || n >= (1ull << 31)) return NULL;
+    *len = (size_t)n;
+    if (n == 0 && !allow_empty) return NULL;
+    char *p = (char*)malloc((size_t)n + 1);
+    if (!p) { perror("malloc"); exit(1); }
+    if (fread(p, 1, (size_t)n, f) != n) { free(p); return NULL; }
+    p[n] = '\0';
+    return p;
+}
+
+/* read in.txt from f (rewound) into the log */
+void record_program(FILE *f) {
+    double t0 = now_seconds();
+    rec_program.text = read_input(f, &rec_program.len);
+    rewind(f);
+    record_seconds += now_seconds() - t0;
+}
+
+/* write the log, before the program runs; 0 if it cannot be written */
+int record_start(const char *file, int engine, int optimize, unsigned spec_threads,
+                 size_t spec_block, uint64_t max_steps, double deadline, size_t max_memory) {
+    double t0 = now_seconds();
+    rec.magic = RECORD_MAGIC;
+    rec.version = RECORD_VERSION;
+    rec.engine = (uint8_t)engine;
+    rec.optimize = (uint8_t)optimize;
+    rec.diag_format = (uint8_t)diag_format;
+    rec.stop = STOP_UNKNOWN;
+    rec.unroll = unroll_factor;
+    rec.spec_threads = spec_threads;
+    rec.diag_max = diag_max;
+    rec.spec_block = spec_block;
+    rec.max_steps = max_steps;
+    rec.max_memory = max_memory;
+    rec.deadline = deadline;
+    if (!(rec_file = fopen(file, "wb"))) { perror(file); return 0; }
+    int ok = fwrite(&rec, sizeof rec, 1, rec_file) == 1;
+    for (uint32_t i = 0; ok && i < rec.nshared; i++) ok = write_string(rec_file, rec_shared[i]);
+    for (uint32_t i = 0; ok && i < rec.nresolved; i++)
+        ok = write_string(rec_file, rec_resolved[i].dir) && write_string(rec_file, rec_resolved[i].spec)
+          && write_string(rec_file, rec_resolved[i].path);
+    for (uint32_t i = 0; ok && i < rec.nsources; i++)
+        ok = write_string(rec_file, rec_sources[i].path)
+          && write_blob(rec_file, rec_sources[i].text, rec_sources[i].len);
+    ok = ok && write_blob(rec_file, rec_program.text, rec_program.len) && fflush(rec_file) == 0;
+    record_bytes = ftell(rec_file);
+    record_seconds += now_seconds() - t0;
+    if (!ok) { perror(file); return 0; }
+    return 1;
+}
+
+/* patch the outcome of the run into the log and close it */
+void record_finish(const Exec *ex) {
+    if (!rec_file) return;
+    double t0 = now_seconds();
+    rec.stop = ex->deadline_hit ? STOP_DEADLINE : STOP_END;
+    rec.steps = ex->issued - ex->fuel;
+    if (fseek(rec_file, 0, SEEK_SET) != 0 || fwrite(&rec, sizeof rec, 1, rec_file) != 1)
+        perror("record");
+    fclose(rec_file);
+    rec_file = NULL;
+    record_seconds += now_seconds() - t0;
+}
+
+/* load a log for -replay and set the recorded options; 0 if it cannot be read */
+int replay_load(const char *file, int *engine, int *optimize, int *spec_threads,
+                size_t *spec_block, uint64_t *max_steps, size_t *max_memory) {
+    FILE *f = fopen(file, "rb");
+    size_t len;
+    if (!f) { perror(file); return 0; }
+    int ok = fread(&rec, sizeof rec, 1, f) == 1 && rec.magic == RECORD_MAGIC &&
+             rec.version == RECORD_VERSION && rec.engine <= ENGINE_SPECULATE &&
+             rec.nshared < 4096 && rec.nresolved < (1u << 20) && rec.nsources < (1u << 20);
+    if (ok) {
+        rec_shared = (char**)calloc(rec.nshared + 1, sizeof(char*));
+        rec_resolved = (Resolution*)calloc(rec.nresolved + 1, sizeof(Resolution));
+        rec_sources = (Source*)calloc(rec.nsources + 1, sizeof(Source));
+        if (!rec_shared || !rec_resolved || !rec_sources) { perror("calloc"); exit(1); }
+    }
+    for (uint32_t i = 0; ok && i < rec.nshared; i++)
+        ok = (rec_shared[i] = read_blob(f, &len, 0)) != NULL;
+    for (uint32_t i = 0; ok && i < rec.nresolved; i++) {
+        ok = (rec_resolved[i].dir = read_blob(f, &len, 0)) && (rec_resolved[i].spec = read_blob(f, &len, 1));
+        char *path = ok ? read_blob(f, &len, 1) : NULL;
+        ok = path != NULL;
+        if (ok && len) rec_resolved[i].path = path;
+        else free(path);
+    }
+    for (uint32_t i = 0; ok && i < rec.nsources; i++)
+        ok = (rec_sources[i].path = read_blob(f, &len, 0))
+          && (rec_sources[i].text = (unsigned char*)read_blob(f, &rec_sources[i].len, 1));
+    ok = ok && (rec_program.text = (unsigned char*)read_blob(f, &rec_program.len, 1));
+    fclose(f);
+    if (!ok) { fprintf(stderr, "%s: not a recording\n", file); return 0; }
+    for (uint32_t i = 0; i < rec.nshared; i++)
+        if (!shared_define(rec_shared[i])) { fprintf(stderr, "%s: bad -shared %s\n", file, rec_shared[i]); return 0; }
+    *engine = rec.engine;
+    *optimize = rec.optimize;
+    *spec_threads = rec.engine == ENGINE_SPECULATE ? (int)rec.spec_threads : -1;
+    *spec_block = (size_t)rec.spec_block;
+    *max_steps = rec.max_steps;
+    *max_memory = (size_t)rec.max_memory;
+    unroll_factor = rec.unroll;
+    diag_format = rec.diag_format;
+    diag_max = rec.diag_max;
+    record_mode = RECORD_REPLAY;
+    return 1;
+}
+
+/* the recorded in.txt, as a stream */
+FILE *replay_program(void) {
+    return memory_file(&rec_program);
+}
+
+/* after exec_set_limits(): a recorded deadline becomes a budget ending at
+   the statement it stopped */
+void replay_limits(Exec *ex) {
+    if (record_mode != RECORD_REPLAY || rec.stop != STOP_DEADLINE) return;
+    ex->budget = rec.steps;
+    ex->budget_is_deadline = 1;
+}
+
+void record_free(void) {
+    for (uint32_t i = 0; i < rec.nresolved; i++) {
+        free(rec_resolved[i].dir);
+        free(rec_resolved[i].spec);
+        free(rec_resolved[i].path);
+    }
+    for (uint32_t i = 0; i < rec.nsources; i++) {
+        free(rec_sources[i].path);
+        free(rec_sources[i].text);
+    }
+    if (record_mode == RECORD_REPLAY)
+        for (uint32_t i = 0; i < rec.nshared; i++) free(rec_shared[i]);
+    free(rec_resolved);
+    free(rec_sources);
+    free(rec_shared);
+    free(rec_program.text);
+    rec_resolved = NULL;
+    rec_sources = NULL;
+    rec_shared = NULL;
+    rec_program.text = NULL;
+}
+
+/* ---- modules ----
+   `import "file";` runs the statements of another source file at that
+   point, as if its text stood there. An imported file is a module: it is
+   lexed and parsed on its own into an image (its nodes, children before
+   parents, in the layout of the AST arrays; the names of its variables; the
+   files it imports in turn) and the image is saved in module_cache_dir
+   under a hash of the source. Later runs load the image instead of parsing
+   the module again, so only a module that changed is compiled again.
+   Importing links the image into the program's AST (module_link): names
+   become the program's variable ids and expressions are hash-consed with
+   the program's own.
+
+   The parser cannot be entered again while it runs, so the modules a
+   program imports are loaded before it is parsed (modules_prepare finds
+   the file names in its text). The statements of a module are located at
+   the import that brought them in. */
+#define MODULE_FILE_MAGIC 0x444f4d43u   /* "CMOD" */
+#define MODULE_FILE_VERSION 1u
+
+typedef struct Module {
+    char *path;         /* real path: one module per file */
+    char *name;         /* as first imported, for messages */
+    char *error;        /* why it cannot be imported (NULL: it can) */
+    int loading;        /* its imports are being loaded (finds cycles) */
+    unsigned mapped;    /* map_stamp of its last module_map_vars() */
+    uint64_t hash;      /* of its source; names the cache file */
+    uint32_t nnodes, root, nnames, nspecs;
+    uint8_t *kind, *op;         /* image nodes 1..nnodes; 0 is the null node */
+    uint32_t *lhs, *rhs;
+    int32_t *value;             /* N_VAR: name index, N_IMPORT: spec index */
+    char **names;       /* variables, in order of first use */
+    char **specs;       /* files it imports, relative to its directory */
+    int *deps;          /* module of each spec */
+    int *ids;           /* variable id of each name in the program being parsed */
+} Module;
+
+/* binary image file: header, names, specs (length-prefixed), then the node
+   arrays (host byte order) */
+typedef struct ModuleHeader {
+    uint32_t magic, version;
+    uint64_t hash;
+    uint32_t nnodes, root, nnames, nspecs;
+} ModuleHeader;
+
+Module *module_table = NULL;
+int module_count = 0, module_cap = 0;
+int module_compiling = -1;              /* module being parsed into an image, or -1 */
+const char *module_dir = ".";           /* directory of the program being parsed */
+const char *module_cache_dir = ".modcache";   /* -module-cache */
+unsigned modules_compiled = 0, modules_cached = 0;
+static unsigned map_stamp = 0;
+
+int variable_id(const char *name);
+extern int num_of_v;
+
+static uint64_t module_hash(const unsigned char *p, size_t n) {
+    uint64_t h = 14695981039346656037ull ^ MODULE_FILE_VERSION;
+    for (size_t i = 0; i < n; i++)
+        h = (h ^ p[i]) * 1099511628211ull;
+    return h;
+}
+
+static char *string_copy(const char *s, size_t n) {
+    char *c = (char*)malloc(n + 1);
+    if (!c) { perror("malloc"); exit(1); }
+    memcpy(c, s, n);
+    c[n] = '\0';
+    return c;
+}
+
+/* real path of spec, relative to dir; NULL if there is no such file */
+static char *module_resolve(const char *dir, const char *spec, size_t len) {
+    if (record_mode == RECORD_REPLAY) return replay_resolve(dir, spec, len);
+    char *joined = (char*)malloc(strlen(dir) + len + 2);
+    if (!joined) { perror("malloc"); exit(1); }
+    if (path_is_absolute(spec, len)) joined[0] = '\0';
+    else sprintf(joined, "%s/", dir);
+    strncat(joined, spec, len);
+    char *path = real_path(joined);
+    free(joined);
+    if (record_mode == RECORD_ON) record_resolution(dir, spec, len, path);
+    return path;
+}
+
+static int module_find(const char *path) {
+    for (int i = 0; i < module_count; i++)
+        if (module_table[i].path && strcmp(module_table[i].path, path) == 0) return i;
+    return -1;
+}
+
+/* new module entry; takes path (may be NULL) */
+static int module_new(char *path, const char *spec, size_t len) {
+    if (module_count == module_cap) {
+        module_cap = module_cap ? module_cap * 2 : 16;
+        module_table = (Module*)realloc(module_table, module_cap * sizeof(Module));
+        if (!module_table) { perror("realloc"); exit(1); }
+    }
+    Module *m = &module_table[module_count];
+    memset(m, 0, sizeof *m);
+    m->path = path;
+    m->name = string_copy(spec, len);
+    return module_count++;
+}
+
+/* mark module i as not importable (the first reason is kept) */
+static void module_fail(int i, const char *fmt, ...) {
+    char msg[512];
+    va_list ap;
+    if (module_table[i].error) return;
+    va_start(ap, fmt);
+    vsnprintf(msg, sizeof msg, fmt, ap);
+    va_end(ap);
+    module_table[i].error = string_copy(msg, strlen(msg));
+}
+
+static void image_alloc(Module *m) {
+    size_t n = (size_t)m->nnodes + 1;
+    m->kind = (uint8_t*)calloc(n, 1);
+    m->op = (uint8_t*)calloc(n, 1);
+    m->lhs = (uint32_t*)calloc(n, sizeof(uint32_t));
+    m->rhs = (uint32_t*)calloc(n, sizeof(uint32_t));
+    m->value = (int32_t*)calloc(n, sizeof(int32_t));
+    m->names = (char**)calloc(m->nnames + 1, sizeof(char*));
+    if (!m->kind || !m->op || !m->lhs || !m->rhs || !m->value || !m->names) {
+        perror("calloc");
+        exit(1);
+    }
+}
+
+static void image_free(Module *m) {
+    for (uint32_t i = 0; i < m->nnames; i++) free(m->names[i]);
+    for (uint32_t i = 0; i < m->nspecs; i++) free(m->specs[i]);
+    free(m->kind); free(m->op); free(m->lhs); free(m->rhs); free(m->value);
+    free(m->names); free(m->specs);
+    m->kind = m->op = NULL;
+    m->lhs = m->rhs = NULL;
+    m->value = NULL;
+    m->names = m->specs = NULL;
+    m->nnodes = m->root = m->nnames = m->nspecs = 0;
+}
+
+/* copy what program_root reaches into the image of module m, children
+   first (an explicit stack: statement lists are as deep as they are long).
+   Its specs were collected by module_import() while it was parsed. The
+   variables are the ones the scanner numbered while parsing it, then any
+   -shared ones it uses. A while's N_LOOP is left out and made again by
+   module_link. */
+static void image_from_ast(Module *m, NodeId root) {
+    uint32_t *local = (uint32_t*)calloc(ast_count, sizeof(uint32_t));
+    NodeId *stack = NULL;
+    size_t depth = 0, cap = 0;
+    uint32_t count = 0, nshared = 0;
+    int shared[MAX_SHARED];
+
+    if (!local) { perror("calloc"); exit(1); }
+    /* number the nodes, and find the -shared variables it uses */
+    if (root) {
+        stack = (NodeId*)malloc((cap = 256) * sizeof(NodeId));
+        if (!stack) { perror("malloc"); exit(1); }
+        stack[depth++] = root;
+    }
+    while (depth) {
+        NodeId n = stack[depth - 1], l = AST_LHS(n), r = AST_RHS(n);
+        int kind = AST_KIND(n);
+        if (local[n]) { depth--; continue; }
+        if (kind == N_INT || kind == N_VAR || kind == N_IMPORT) l = r = 0;
+        if (depth + 2 > cap) {
+            stack = (NodeId*)realloc(stack, (cap *= 2) * sizeof(NodeId));
+            if (!stack) { perror("realloc"); exit(1); }
+        }
+        if (l && !local[l]) { stack[depth++] = l; continue; }
+        if (r && !local[r]) { stack[depth++] = r; continue; }
+        depth--;
+        local[n] = ++count;
+        if (kind == N_VAR && AST_VALUE(n) >= SHARED_BASE) {
+            uint32_t k = 0;
+            while (k < nshared && shared[k] != AST_VALUE(n)) k++;
+            if (k == nshared) shared[nshared++] = AST_VALUE(n);
+        }
+    }
+    free(stack);
+
+    m->nnodes = count;
+    m->root = root ? local[root] : 0;
+    m->nnames = (uint32_t)num_of_v + nshared;
+    image_alloc(m);
+    for (int id = 1; id <= num_of_v; id++) {
+        const char *name = variable_name(id);
+        m->names[id - 1] = string_copy(name, strlen(name));
+    }
+    for (uint32_t k = 0; k < nshared; k++) {
+        const char *name = shared_vars[shared[k] - SHARED_BASE].name;
+        m->names[num_of_v + k] = string_copy(name, strlen(name));
+    }
+    for (NodeId n = 1; n < ast_count; n++) {
+        uint32_t i = local[n];
+        int kind = AST_KIND(n);
+        if (!i) continue;
+        m->kind[i] = (uint8_t)kind;
+        m->op[i] = AST_OP(n);
+        if (kind != N_INT && kind != N_VAR && kind != N_IMPORT) {
+            m->lhs[i] = local[AST_LHS(n)];
+            m->rhs[i] = local[AST_RHS(n)];
+        }
+        if (kind == N_INT || kind == N_IMPORT) {
+            m->value[i] = AST_VALUE(n);
+        } else if (kind == N_VAR) {
+            int id = AST_VALUE(n);
+            uint32_t k = 0;
+            if (id < SHARED_BASE) {
+                m->value[i] = id - 1;
+                continue;
+            }
+            while (shared[k] != id) k++;
+            m->value[i] = (int32_t)(num_of_v + k);
+        }
+    }
+    free(local);
+}
+
+/* an image read back is checked before it is linked: children come
+   before their parents, the indexes are in range and every node has the
+   shape the parser gives it (operators, child kinds, a list at the root),
+   so neither linking nor running it needs to check again */
+static int image_expr(const Module *m, uint32_t i) {
+    return i && (m->kind[i] == N_INT || m->kind[i] == N_VAR || m->kind[i] == N_OP ||
+                 m->kind[i] == N_INDEX);
+}
+
+static int image_list(const Module *m, uint32_t i) {
+    return !i || m->kind[i] == N_STMTLIST;
+}
+
+static int image_stmt(const Module *m, uint32_t i) {
+    switch (i ? m->kind[i] : N_UNKNOWN) {
+        case N_DECL: case N_ASSIGN: case N_PRINT: case N_IF: case N_WHILE:
+        case N_MAPDECL: case N_MAPSET: case N_MAPDEL: case N_IMPORT:
+            return 1;
+    }
+    return 0;
+}
+
+static int image_valid(const Module *m) {
+    if (m->root > m->nnodes || !image_list(m, m->root)) return 0;
+    for (uint32_t i = 1; i <= m->nnodes; i++) {
+        uint32_t l = m->lhs[i], r = m->rhs[i];
+        if (l >= i || r >= i) return 0;
+        if (m->kind[i] == N_OP ? m->op[i] < OP_ADD || m->op[i] > OP_GT : m->op[i] != OP_NONE)
+            return 0;
+        int ok;
+        switch (m->kind[i]) {
+            case N_INT:
+                ok = !l && !r;
+                break;
+            case N_VAR:
+                ok = !l && !r && (uint32_t)m->value[i] < m->nnames;
+                break;
+            case N_IMPORT:
+                ok = !l && !r && (uint32_t)m->value[i] < m->nspecs;
+                break;
+            case N_OP:
+                ok = image_expr(m, l) && image_expr(m, r);
+                break;
+            case N_INDEX: case N_DECL: case N_ASSIGN:
+                ok = l && m->kind[l] == N_VAR && image_expr(m, r);
+                break;
+            case N_PRINT:
+                ok = image_expr(m, l) && !r;
+                break;
+            case N_MAPDECL:
+                ok = l && m->kind[l] == N_VAR && !r;
+                break;
+            case N_MAPSET:
+                ok = l && m->kind[l] == N_INDEX && image_expr(m, r);
+                break;
+            case N_MAPDEL:
+                ok = l && m->kind[l] == N_INDEX && !r;
+                break;
+            case N_IF:
+                ok = image_expr(m, l) && r && m->kind[r] == N_BRANCHES;
+                break;
+            case N_BRANCHES:
+                ok = image_list(m, l) && image_list(m, r);
+                break;
+            case N_WHILE:
+                ok = image_expr(m, l) && image_list(m, r);
+                break;
+            case N_STMTLIST:
+                ok = image_list(m, l) && image_stmt(m, r);
+                break;
+            default:
+                ok = 0;
+        }
+        if (!ok) return 0;
+    }
+    return 1;
+}
+
+static int write_strings(FILE *f, char **s, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t len = (uint32_t)strlen(s[i]);
+        if (fwrite(&len, sizeof len, 1, f) != 1 || fwrite(s[i], 1, len, f) != len) return 0;
+    }
+    return 1;
+}
+
+static int read_strings(FILE *f, char **s, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t len;
+        if (fread(&len, sizeof len, 1, f) != 1 || len > 4096) return 0;
+        s[i] = (char*)malloc(len + 1);
+        if (!s[i]) { perror("malloc"); exit(1); }
+        if (fread(s[i], 1, len, f) != len) return 0;
+        s[i][len] = '\0';
+    }
+    return 1;
+}
+
+static void cache_file(char *buf, size_t size, uint64_t hash) {
+    snprintf(buf, size, "%s/%016llx.mod", module_cache_dir, (unsigned long long)hash);
+}
+
+/* load the cached image of module m; 0 if there is none (or it is not
+   usable), and the module is compiled instead */
+static int image_read(Module *m) {
+    char file[4096];
+    ModuleHeader h;
+    cache_file(file, sizeof file, m->hash);
+    FILE *f = fopen(file, "rb");
+    if (!f) return 0;
+    int ok = fread(&h, sizeof h, 1, f) == 1 && h.magic == MODULE_FILE_MAGIC &&
+             h.version == MODULE_FILE_VERSION && h.hash == m->hash &&
+             h.nnodes < (1u << 26) && h.nnames <= MAX_VARS && h.nspecs < (1u << 16);
+    if (ok) {
+        size_t n = (size_t)h.nnodes;
+        m->nnodes = h.nnodes;
+        m->root = h.root;
+        m->nnames = h.nnames;
+        m->nspecs = h.nspecs;
+        image_alloc(m);
+        m->specs = (char**)calloc(m->nspecs + 1, sizeof(char*));
+        if (!m->specs) { perror("calloc"); exit(1); }
+        ok = read_strings(f, m->names, m->nnames) && read_strings(f, m->specs, m->nspecs)
+          && fread(m->kind + 1, 1, n, f) == n && fread(m->op + 1, 1, n, f) == n
+          && fread(m->lhs + 1, sizeof(uint32_t), n, f) == n
+          && fread(m->rhs + 1, sizeof(uint32_t), n, f) == n
+          && fread(m->value + 1, sizeof(int32_t), n, f) == n
+          && image_valid(m);
+        if (!ok) image_free(m);
+    }
+    fclose(f);
+    return ok;
+}
+
+/* save the image of module m in the cache; written to a temporary file
+   and renamed, so a concurrent run never reads half an image. A cache
+   that cannot be written only costs the next run a compile. */
+static void image_write(const Module *m) {
+    char file[4096], tmp[4200];
+    ModuleHeader h = { MODULE_FILE_MAGIC, MODULE_FILE_VERSION, m->hash,
+                       m->nnodes, m->root, m->nnames, m->nspecs };
+    size_t n = (size_t)m->nnodes;
+    make_dir(module_cache_dir);
+    cache_file(file, sizeof file, m->hash);
+    snprintf(tmp, sizeof tmp, "%s.%ld", file, (long)getpid());
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return;
+    int ok = fwrite(&h, sizeof h, 1, f) == 1
+          && write_strings(f, m->names, m->nnames) && write_strings(f, m->specs, m->nspecs)
+          && fwrite(m->kind + 1, 1, n, f) == n && fwrite(m->op + 1, 1, n, f) == n
+          && fwrite(m->lhs + 1, sizeof(uint32_t), n, f) == n
+          && fwrite(m->rhs + 1, sizeof(uint32_t), n, f) == n
+          && fwrite(m->value + 1, sizeof(int32_t), n, f) == n;
+    if (fclose(f) != 0) ok = 0;
+    if (!ok || rename(tmp, file) != 0) remove(tmp);
+}
+
+/* parse module i from f into its image. The program's parse has not
+   started yet; the nodes the module needed are dropped again. */
+static void module_compile(int i, FILE *f) {
+    ErrorList errors = { 0 };
+    ErrorList *saved_errors = pending_errors;
+    MemLimit *saved_mem = mem_current;
+    FILE *saved_in = yyin;
+    NodeId saved_root = program_root, mark = ast_count;
+
+    pending_errors = &errors;
+    mem_current = NULL;
+    program_root = 0;
+    module_compiling = i;
+    scanner_reset(f, 0);
+    int status = yyparse();
+    module_compiling = -1;
+    if (errors.count) {
+        int line, col;
+        offset_to_line_col(errors.items[0].offset, &line, &col);
+        module_fail(i, "%s in module %s (line %d, column %d)", errors.items[0].msg,
+                    module_table[i].name, line, col);
+    } else if (status != 0) {
+        module_fail(i, "syntax error in module %s", module_table[i].name);
+    } else {
+        image_from_ast(&module_table[i], program_root);
+    }
+    ast_rollback(mark);
+    free(errors.items);
+    pending_errors = saved_errors;
+    mem_current = saved_mem;
+    program_root = saved_root;
+    yyin = saved_in;
+    modules_compiled++;
+    metric_add(M_MODULE_COMPILES, 1);
+}
+
+/* module of spec (relative to dir), loaded from the cache or compiled,
+   with the modules it imports; -1 if there is no such file */
+static int module_load(const char *dir, const char *spec, size_t len) {
+    char *path = module_resolve(dir, spec, len);
+    if (!path) return -1;
+    int i = module_find(path);
+    if (i >= 0) { free(path); return i; }
+    i = module_new(path, spec, len);
+
+    FILE *f = record_mode == RECORD_REPLAY ? replay_open(path) : fopen(path, "rb");
+    if (!f) { module_fail(i, "Cannot open module %s", module_table[i].name); return i; }
+    size_t size;
+    unsigned char *text = read_input(f, &size);
+    if (record_mode == RECORD_ON) record_source(path, text, size);
+    module_table[i].hash = module_hash(text, size);
+    free(text);
+    if (image_read(&module_table[i])) {
+        modules_cached++;
+        metric_add(M_MODULE_HITS, 1);
+    } else {
+        rewind(f);
+        module_compile(i, f);
+        if (!module_table[i].error) image_write(&module_table[i]);
+    }
+    fclose(f);
+    if (module_table[i].error) return i;
+
+    /* the modules it imports, relative to its own directory */
+    char *own_dir = string_copy(path, strlen(path));
+    path_dirname(own_dir);
+    uint32_t nspecs = module_table[i].nspecs;
+    module_table[i].deps = (int*)malloc((nspecs + 1) * sizeof(int));
+    module_table[i].ids = (int*)malloc((module_table[i].nnames + 1) * sizeof(int));
+    if (!module_table[i].deps || !module_table[i].ids) { perror("malloc"); exit(1); }
+    module_table[i].loading = 1;
+    for (uint32_t k = 0; k < nspecs; k++) {
+        const char *s = module_table[i].specs[k];
+        int d = module_load(own_dir, s, strlen(s));
+        module_table[i].deps[k] = d;
+        if (d < 0) module_fail(i, "Cannot open module %s", s);
+        else if (module_table[d].loading) module_fail(i, "Import cycle through module %s", module_table[d].name);
+        else if (module_table[d].error) module_fail(i, "%s", module_table[d].error);
+    }
+    module_table[i].loading = 0;
+    free(own_dir);
+    return i;
+}
 
-/* condition: produce expression-op node (left op right) */
-condition:
-      expr OP expr
-      {
-          /* OP is a string (lexer must strdup) */
-          $$ = new_op_node($2, $1, $3);
-          /* We do not evaluate now; evaluation happens at run-time via eval_expr */
-          free($2); /* free strdup from lexer to avoid leak */
-      }
-    ;
+static int imports_found;
 
-/* arithmetic expressions: build expression tree (no runtime evaluation now) */
-expr:
-      INTEGER
-      {
-          $$ = new_int_node($1);
-      }
-    | VARIABLE
-      {
-          $$ = new_var_node($1);
-      }
-    | expr '+' expr
-      {
-          $$ = new_op_node("+", $1, $3);
-      }
-    | expr '-' expr
-      {
-          $$ = new_op_node("-", $1, $3);
-      }
-    | expr '*' expr
-      {
-          $$ = new_op_node("*", $1, $3);
-      }
-    | expr '/' expr
-      {
-          $$ = new_op_node("/", $1, $3);
-      }
-    | '(' expr ')'
-      {
-          $$ = $2;
-      }
-    ;
+static void prepare_import(const char *spec, size_t len) {
+    module_load(module_dir, spec, len);
+    imports_found++;
+}
 
-%%
+/* load the modules the program in f imports, before it is parsed (the
+   IMPORT STRING pairs of its tokens); f is rewound. Returns the number of
+   imports found. */
+int modules_prepare(FILE *f, const char *dir) {
+    size_t len;
+    unsigned char *text = read_input(f, &len);
+    module_dir = dir;
+    imports_found = 0;
+    tokens_find_imports(text, len, prepare_import);
+    free(text);
+    rewind(f);
+    return imports_found;
+}
 
-/* error reporting */
-void yyerror(char *s) {
-    if (!yyError) yyError = stderr;
-    fprintf(yyError, "Error: %s at line %d\n", s, yylineno);
+/* give the variables of module i (and of the modules it imports) ids in
+   the program being parsed, in the order the names first occur */
+static void module_map_vars(int i) {
+    Module *m = &module_table[i];
+    if (m->mapped == map_stamp) return;
+    m->mapped = map_stamp;
+    for (uint32_t k = 0; k < m->nnames; k++)
+        m->ids[k] = variable_id(m->names[k]);
+    for (uint32_t k = 0; k < m->nspecs; k++)
+        module_map_vars(m->deps[k]);
+}
+
+/* value of a STRING token (called by the scanner). While a module is
+   compiled it is the index of the file in the module's specs; otherwise
+   the module, whose variables get their ids here, in token order, so the
+   program numbers them as if the module's text stood at the import. */
+int module_import(const char *spec, size_t len) {
+    if (module_compiling >= 0) {
+        Module *m = &module_table[module_compiling];
+        for (uint32_t k = 0; k < m->nspecs; k++)
+            if (strlen(m->specs[k]) == len && memcmp(m->specs[k], spec, len) == 0) return (int)k;
+        m->specs = (char**)realloc(m->specs, (m->nspecs + 1) * sizeof(char*));
+        if (!m->specs) { perror("realloc"); exit(1); }
+        m->specs[m->nspecs] = string_copy(spec, len);
+        return (int)m->nspecs++;
+    }
+    char *path = module_resolve(module_dir, spec, len);
+    int i = path ? module_find(path) : -1;
+    if (i >= 0) {
+        free(path);
+    } else {
+        /* not loaded by modules_prepare: no such file, or a string that
+           does not follow import (a syntax error) */
+        i = module_new(path, spec, len);
+        module_fail(i, "Cannot open module %s", module_table[i].name);
+    }
+    if (!module_table[i].error) {
+        map_stamp++;
+        module_map_vars(i);
+    }
+    return i;
+}
+
+/* the import statement. In a module it stays in the image; in a program
+   it only carries the module and its location to append_stmt() */
+NodeId new_import_node(int module, uint32_t offset) {
+    if (module_compiling >= 0) return new_node_kind(N_IMPORT, OP_NONE, 0, 0, module);
+    if (module_table[module].error) {
+        error_at(module_table[module].error, offset);
+        return 0;
+    }
+    return new_node_kind(N_IMPORT, OP_NONE, 0, offset, module);
+}
+
+static NodeId module_link(int i, NodeId list, uint32_t offset);
+
+static NodeId link_expr(const Module *m, NodeId *memo, uint32_t e) {
+    if (!e) return 0;
+    if (!memo[e]) {
+        if (m->kind[e] == N_VAR)
+            memo[e] = new_var_node(m->ids[m->value[e]]);
+        else
+            memo[e] = hashcons_node(m->kind[e], m->op[e], link_expr(m, memo, m->lhs[e]),
+                                    link_expr(m, memo, m->rhs[e]), m->value[e]);
+    }
+    return memo[e];
+}
+
+static NodeId link_list(const Module *m, NodeId *memo, uint32_t l, NodeId list, uint32_t offset);
+
+/* statements are made in the order the parser makes them (an if or while
+   before its blocks), so loc_table stays sorted */
+static NodeId link_stmt(const Module *m, NodeId *memo, uint32_t s, uint32_t offset) {
+    NodeId n;
+    switch (m->kind[s]) {
+        case N_IF: {
+            uint32_t b = m->rhs[s];
+            n = loc_record(new_if_node(link_expr(m, memo, m->lhs[s])), offset);
+            NodeId then_list = link_list(m, memo, m->lhs[b], 0, offset);
+            return finish_if_node(n, then_list, link_list(m, memo, m->rhs[b], 0, offset));
+        }
+        case N_WHILE:
+            n = loc_record(new_while_node(link_expr(m, memo, m->lhs[s])), offset);
+            return finish_while_node(n, link_list(m, memo, m->rhs[s], 0, offset));
+        default:
+            n = new_node_kind(m->kind[s], OP_NONE, link_expr(m, memo, m->lhs[s]),
+                              link_expr(m, memo, m->rhs[s]), 0);
+            return loc_record(n, offset);
+    }
+}
+
+/* append the statements of image list l to list */
+static NodeId link_list(const Module *m, NodeId *memo, uint32_t l, NodeId list, uint32_t offset) {
+    uint32_t count = 0, *stmts;
+    for (uint32_t k = l; k; k = m->lhs[k]) count++;
+    if (!count) return list;
+    stmts = (uint32_t*)malloc(count * sizeof(uint32_t));
+    if (!stmts) { perror("malloc"); exit(1); }
+    for (uint32_t k = l, j = count; k; k = m->lhs[k]) stmts[--j] = m->rhs[k];
+    for (uint32_t j = 0; j < count; j++) {
+        uint32_t s = stmts[j];
+        if (m->kind[s] == N_IMPORT) list = module_link(m->deps[m->value[s]], list, offset);
+        else list = new_stmtlist_node(list, link_stmt(m, memo, s, offset));
+    }
+    free(stmts);
+    return list;
+}
+
+/* append the statements of module i to list, located at offset */
+static NodeId module_link(int i, NodeId list, uint32_t offset) {
+    const Module *m = &module_table[i];
+    NodeId *memo = (NodeId*)calloc((size_t)m->nnodes + 1, sizeof(NodeId));
+    if (!memo) { perror("calloc"); exit(1); }
+    list = link_list(m, memo, m->root, list, offset);
+    free(memo);
+    return list;
+}
+
+/* add a statement to a statement list; an import adds its module's */
+NodeId append_stmt(NodeId list, NodeId stmt) {
+    if (AST_KIND(stmt) == N_IMPORT && module_compiling < 0)
+        return module_link(AST_VALUE(stmt), list, AST_RHS(stmt));
+    return new_stmtlist_node(list, stmt);
+}
+
+void modules_free(void) {
+    for (int i = 0; i < module_count; i++) {
+        Module *m = &module_table[i];
+        image_free(m);
+        free(m->path);
+        free(m->name);
+        free(m->error);
+        free(m->deps);
+        free(m->ids);
+    }
+    free(module_table);
+    module_table = NULL;
+    module_count = module_cap = 0;
+}
+
+/* ---- pipelined lexer / parser / executor ----
+   With -pipeline the three stages run on their own threads. The lexer pushes
+   packed tokens into a single-producer/single-consumer ring that the parser
+   reads through token_source, and the parser pushes every completed
+   top-level statement into a second ring that the executor (main thread)
+   drains. Throughput then approaches that of the slowest stage. A stage
+   only reads the clock when it has to wait, so the stall times reported by
+   -time cost nothing while data is flowing. AST nodes never move once
+   created, so the executor can read a statement the parser is done with. */
+
+/* Every thread here that finds nothing to do (a stage on an empty or full
+   ring, an idle -batch worker or -speculate helper, the main thread waiting
+   for results) calls idle_wait with a count of its failed passes, reset to
+   0 when it finds work: the first IDLE_SPINS passes only yield, then it
+   sleeps, from 50 us doubling up to 800 us, so a thread kept waiting (a
+   long program on another worker, -serve between requests) stops using a
+   CPU without slowing the handoffs that come quickly. */
+#define IDLE_SPINS 64
+
+void idle_wait(unsigned *passes) {
+    if (*passes < IDLE_SPINS) {
+        ++*passes;
+        sched_yield();
+        return;
+    }
+    unsigned shift = *passes - IDLE_SPINS;
+    if (shift < 4) ++*passes;
+    struct timespec ts = { 0, 50000L << shift };
+    nanosleep(&ts, NULL);
+}
+
+typedef struct SpscQueue {
+    _Atomic size_t head;        /* next slot to read; written by the consumer */
+    size_t tail_cache;          /* consumer's last view of tail */
+    char pad1[CACHE_LINE - 2 * sizeof(size_t)];
+    _Atomic size_t tail;        /* next slot to write; written by the producer */
+    size_t head_cache;          /* producer's last view of head */
+    char pad2[CACHE_LINE - 2 * sizeof(size_t)];
+    size_t mask;                /* capacity - 1, capacity is a power of two */
+    size_t item_size;
+    unsigned char *items;
+} SpscQueue;
+
+void queue_init(SpscQueue *q, size_t capacity, size_t item_size) {
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    q->tail_cache = q->head_cache = 0;
+    q->mask = capacity - 1;
+    q->item_size = item_size;
+    q->items = (unsigned char*)malloc(capacity * item_size);
+    if (!q->items) { perror("malloc"); exit(1); }
+}
+
+/* push one item, waiting while the ring is full; waiting time goes to *stall */
+void queue_push(SpscQueue *q, const void *item, double *stall) {
+    size_t t = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    if (t - q->head_cache > q->mask) {
+        q->head_cache = atomic_load_explicit(&q->head, memory_order_acquire);
+        if (t - q->head_cache > q->mask) {
+            double start = now_seconds();
+            unsigned passes = 0;
+            do {
+                idle_wait(&passes);
+                q->head_cache = atomic_load_explicit(&q->head, memory_order_acquire);
+            } while (t - q->head_cache > q->mask);
+            *stall += now_seconds() - start;
+        }
+    }
+    memcpy(q->items + (t & q->mask) * q->item_size, item, q->item_size);
+    atomic_store_explicit(&q->tail, t + 1, memory_order_release);
+}
+
+/* pop one item, waiting while the ring is empty; waiting time goes to *stall */
+void queue_pop(SpscQueue *q, void *item, double *stall) {
+    size_t h = atomic_load_explicit(&q->head, memory_order_relaxed);
+    if (h == q->tail_cache) {
+        q->tail_cache = atomic_load_explicit(&q->tail, memory_order_acquire);
+        if (h == q->tail_cache) {
+            double start = now_seconds();
+            unsigned passes = 0;
+            do {
+                idle_wait(&passes);
+                q->tail_cache = atomic_load_explicit(&q->tail, memory_order_acquire);
+            } while (h == q->tail_cache);
+            *stall += now_seconds() - start;
+        }
+    }
+    memcpy(item, q->items + (h & q->mask) * q->item_size, q->item_size);
+    atomic_store_explicit(&q->head, h + 1, memory_order_release);
+}
+
+/* pop one item if there is one; returns 0 when the ring is empty */
+int queue_try_pop(SpscQueue *q, void *item) {
+    size_t h = atomic_load_explicit(&q->head, memory_order_relaxed);
+    if (h == q->tail_cache) {
+        q->tail_cache = atomic_load_explicit(&q->tail, memory_order_acquire);
+        if (h == q->tail_cache) return 0;
+    }
+    memcpy(item, q->items + (h & q->mask) * q->item_size, q->item_size);
+    atomic_store_explicit(&q->head, h + 1, memory_order_release);
+    return 1;
+}
+
+typedef struct Pipeline {
+    SpscQueue tokens;           /* lexer -> parser, Token */
+    SpscQueue stmts;            /* parser -> executor, NodeId (0 ends the stream) */
+    double lex_stall;           /* lexer waiting for room in tokens */
+    double parse_wait;          /* parser waiting for tokens */
+    double parse_stall;         /* parser waiting for room in stmts */
+    double exec_wait;           /* executor waiting for statements */
+    int tokens_done;            /* parser has taken the end token */
+    int parse_status;           /* yyparse() result */
+    ErrorList lex_errors, parse_errors, exec_errors;
+} Pipeline;
+
+struct Pipeline *pipe_state = NULL;
+
+int pipeline_next_token(void) {
+    Token t;
+    queue_pop(&pipe_state->tokens, &t, &pipe_state->parse_wait);
+    if (t.kind == 0) pipe_state->tokens_done = 1;
+    return token_apply(&t);
+}
+
+void pipeline_emit(NodeId stmt) {
+    queue_push(&pipe_state->stmts, &stmt, &pipe_state->parse_stall);
+}
+
+static void *lexer_thread(void *arg) {
+    Pipeline *p = (Pipeline*)arg;
+    Token t;
+    pending_errors = &p->lex_errors;
+    do {
+        t = lex_token();
+        queue_push(&p->tokens, &t, &p->lex_stall);
+    } while (t.kind != 0);
+    return NULL;
+}
+
+static void *parser_thread(void *arg) {
+    Pipeline *p = (Pipeline*)arg;
+    NodeId end = 0;
+    pending_errors = &p->parse_errors;
+    p->parse_status = yyparse();
+    /* after a syntax error, drain the tokens so the lexer can finish */
+    while (!p->tokens_done) pipeline_next_token();
+    queue_push(&p->stmts, &end, &p->parse_stall);
+    return NULL;
+}
+
+/* run lexer, parser and executor on three threads; returns yyparse()'s
+   result. Statements before a syntax error have already run by the time
+   it is found. */
+int run_pipeline(Exec *ex, int show_times) {
+    Pipeline p;
+    pthread_t lexer, parser;
+    NodeId stmt;
+
+    memset(&p, 0, sizeof p);
+    queue_init(&p.tokens, 1 << 14, sizeof(Token));
+    queue_init(&p.stmts, 1 << 10, sizeof(NodeId));
+    pipe_state = &p;
+    token_source = pipeline_next_token;
+
+    double start = now_seconds();
+    if (pthread_create(&lexer, NULL, lexer_thread, &p) != 0 ||
+        pthread_create(&parser, NULL, parser_thread, &p) != 0) {
+        perror("pthread_create");
+        exit(1);
+    }
+    pending_errors = &p.exec_errors;
+    for (;;) {
+        queue_pop(&p.stmts, &stmt, &p.exec_wait);
+        if (!stmt) break;
+        execute_list(ex, stmt);
+    }
+    pending_errors = NULL;
+    pthread_join(lexer, NULL);
+    pthread_join(parser, NULL);
+    double total = now_seconds() - start;
+    pipe_state = NULL;
+    token_source = NULL;
+
+    flush_front_end_errors(&p.lex_errors, &p.parse_errors);
+    for (size_t i = 0; i < p.exec_errors.count; i++)
+        print_error(p.exec_errors.items[i].msg,
+                    runtime_error_offset(p.exec_errors.items[i].stmt, p.exec_errors.items[i].use));
+
+    if (show_times) {
+        fprintf(stderr, "pipeline: %8.3f ms total\n", total * 1e3);
+        fprintf(stderr, "  lexer    stalled %8.3f ms on a full token queue\n", p.lex_stall * 1e3);
+        fprintf(stderr, "  parser   waited  %8.3f ms for tokens, stalled %8.3f ms on a full statement queue\n",
+                p.parse_wait * 1e3, p.parse_stall * 1e3);
+        fprintf(stderr, "  executor waited  %8.3f ms for statements\n", p.exec_wait * 1e3);
+    }
+    free(p.tokens.items);
+    free(p.stmts.items);
+    free(p.exec_errors.items);
+    return p.parse_status;
+}
+
+/* ---- batch scheduler ----
+   -batch DIR... runs many programs at once. Each program is DIR/in.txt and
+   its out.txt, tree.txt and outError.txt are written to the same DIR. The
+   programs are parsed one after another (the parser is not reentrant) and
+   then run as green threads: a program runs a slice of statements
+   (-slice N), then goes to the back of its worker's queue, so a short
+   program never waits behind a long one. The workers (-workers N, default
+   one per CPU) each own a work-stealing deque and take programs from the
+   other deques when their own is empty. The main thread writes a
+   program's results as soon as it finishes.
+   With -fork DIR... the programs are continuations of in.txt instead: each
+   starts from a copy-on-write fork of the state in.txt ended in
+   (exec_fork) and sees its variables, so the common prefix runs once. */
+typedef struct Program {
+    const char *dir;
+    Exec ex;
+    uint32_t *lines;            /* the scanner's line table for this source */
+    int line_count;
+    MemLimit mem;
+    ErrorList front_errors;     /* lexer and parser errors, in order */
+    ErrorList exec_errors;
+    double started;             /* now_seconds() when its first slice began */
+    double finished;            /* now_seconds() when its last slice ended */
+} Program;
+
+/* Chase-Lev deque without the owner's pop: the owner pushes at the bottom
+   and every worker, the owner included, takes from the top, so a worker
+   runs its own programs round-robin. A deque never holds more than all the
+   programs and is sized for that, so it never grows. */
+typedef struct WorkDeque {
+    _Atomic size_t top;         /* next program to take */
+    char pad1[CACHE_LINE - sizeof(size_t)];
+    _Atomic size_t bottom;      /* next free slot; written by the owner */
+    char pad2[CACHE_LINE - sizeof(size_t)];
+    size_t mask;
+    _Atomic(Program*) *items;
+} WorkDeque;
+
+void deque_init(WorkDeque *d, size_t capacity) {
+    atomic_init(&d->top, 0);
+    atomic_init(&d->bottom, 0);
+    d->mask = capacity - 1;
+    d->items = (_Atomic(Program*)*)calloc(capacity, sizeof *d->items);
+    if (!d->items) { perror("calloc"); exit(1); }
+}
+
+/* owner only */
+void deque_push(WorkDeque *d, Program *p) {
+    size_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    atomic_store_explicit(&d->items[b & d->mask], p, memory_order_relaxed);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_release);
+}
+
+/* any thread; NULL when the deque is empty */
+Program *deque_take(WorkDeque *d) {
+    size_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    for (;;) {
+        size_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+        if (t >= b) return NULL;
+        Program *p = atomic_load_explicit(&d->items[t & d->mask], memory_order_relaxed);
+        if (atomic_compare_exchange_weak_explicit(&d->top, &t, t + 1,
+                memory_order_acq_rel, memory_order_acquire))
+            return p;
+    }
+}
+
+typedef struct Batch Batch;
+
+typedef struct Worker {
+    WorkDeque deque;
+    SpscQueue done;             /* finished programs, Program*, read by the main thread */
+    Batch *batch;
+    unsigned id;
+    unsigned long slices, steals;
+    double done_stall;          /* waiting for room in done */
+    pthread_t thread;
+} Worker;
+
+struct Batch {
+    Worker *workers;
+    unsigned nworkers;
+    uint32_t slice;
+    _Atomic size_t running;     /* programs not finished yet */
+};
+
+static void *worker_thread(void *arg) {
+    Worker *w = (Worker*)arg;
+    Batch *b = w->batch;
+    unsigned idle = 0;
+    metric_slot = 1 + w->id % (METRIC_SHARDS - 1);
+    while (atomic_load_explicit(&b->running, memory_order_acquire)) {
+        Program *p = deque_take(&w->deque);
+        for (unsigned i = 1; !p && i < b->nworkers; i++) {
+            p = deque_take(&b->workers[(w->id + i) % b->nworkers].deque);
+            if (p) w->steals++;
+        }
+        if (!p) { idle_wait(&idle); continue; }
+        idle = 0;
+        w->slices++;
+        if (p->started == 0) p->started = now_seconds();
+        pending_errors = &p->exec_errors;
+        int more = exec_run(&p->ex, b->slice);
+        pending_errors = NULL;
+        if (more) {
+            deque_push(&w->deque, p);
+        } else {
+            p->finished = now_seconds();
+            metric_time(H_EXECUTE, p->finished - p->started);
+            metric_add(M_PROGRAMS, 1);
+            metric_add(M_STATEMENTS, p->ex.issued - p->ex.fuel);
+            queue_push(&w->done, &p, &w->done_stall);
+            atomic_fetch_sub_explicit(&b->running, 1, memory_order_release);
+        }
+    }
+    return NULL;
+}
+
+static FILE *open_in_dir(const char *dir, const char *name, const char *mode) {
+    char path[4096];
+    snprintf(path, sizeof path, "%s/%s", dir, name);
+    FILE *f = fopen(path, mode);
+    if (!f) perror(path);
+    return f;
+}
+
+/* write a finished program's out.txt, tree.txt and outError.txt (main
+   thread: locating errors uses the scanner's line table globals) */
+static void finish_program(Program *p) {
+    ErrorList none = { 0 };
+    FILE *error_file = yyError;
+    uint32_t *lines = line_starts;
+    int lines_used = line_count;
+    if ((p->ex.out.file = open_in_dir(p->dir, "out.txt", "w"))) {
+        out_flush(&p->ex.out);
+        fclose(p->ex.out.file);
+    }
+    if ((p->ex.tree.file = open_in_dir(p->dir, "tree.txt", "w"))) {
+        out_flush(&p->ex.tree);
+        fclose(p->ex.tree.file);
+    }
+    yyError = open_in_dir(p->dir, "outError.txt", "w");
+    line_starts = p->lines;
+    line_count = p->line_count;
+    flush_front_end_errors(&none, &p->front_errors);
+    for (size_t i = 0; i < p->exec_errors.count; i++)
+        print_error(p->exec_errors.items[i].msg,
+                    runtime_error_offset(p->exec_errors.items[i].stmt, p->exec_errors.items[i].use));
+    if (diag_format) diag_flush(yyError);
+    if (yyError) fclose(yyError);
+    yyError = error_file;
+    line_starts = lines;
+    line_count = lines_used;
+    free(p->lines);
+    free(p->exec_errors.items);
+    exec_free(&p->ex);
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+int run_batch(char **dirs, int count, unsigned nworkers, uint32_t slice,
+              uint64_t max_steps, double deadline, size_t max_memory, int show_times,
+              int optimize, const Exec *parent) {
+    Program *progs = (Program*)calloc((size_t)count, sizeof(Program));
+    Worker *workers = (Worker*)calloc(nworkers, sizeof(Worker));
+    double *latency = (double*)malloc((size_t)count * sizeof(double));
+    Batch b;
+    size_t capacity = 1, scheduled = 0, finished = 0;
+    int failed = 0;
+
+    if (!progs || !workers || !latency) { perror("malloc"); exit(1); }
+    while (capacity < (size_t)count) capacity *= 2;
+    b.workers = workers;
+    b.nworkers = nworkers;
+    b.slice = slice;
+    for (unsigned i = 0; i < nworkers; i++) {
+        deque_init(&workers[i].deque, capacity);
+        queue_init(&workers[i].done, 1 << 10, sizeof(Program*));
+        workers[i].batch = &b;
+        workers[i].id = i;
+    }
+
+    /* parse every program and deal them out to the workers */
+    double t0 = now_seconds();
+    for (int i = 0; i < count; i++) {
+        Program *p = &progs[i];
+        FILE *in = open_in_dir(dirs[i], "in.txt", "r");
+        p->dir = dirs[i];
+        p->mem.limit = max_memory;
+        if (parent) exec_fork(&p->ex, parent, NULL, NULL, &p->mem);
+        else exec_init(&p->ex, NULL, NULL, &p->mem);
+        if (!in) { failed = 1; continue; }
+        double tp = now_seconds();
+        modules_prepare(in, dirs[i]);
+        scanner_reset(in, parent != NULL);
+        program_root = 0;
+        pending_errors = &p->front_errors;
+        mem_current = &p->mem;
+        if (yyparse() == 0) {
+            if (optimize) optimize_program(program_root, NULL);
+            exec_push_list(&p->ex, program_root);
+        }
+        mem_current = NULL;
+        pending_errors = NULL;
+        fclose(in);
+        metric_time(H_PARSE, now_seconds() - tp);
+        metric_arena();
+        p->lines = scanner_take_lines(&p->line_count);
+        deque_push(&workers[scheduled % nworkers].deque, p);
+        scheduled++;
+    }
+    yyin = NULL;
+
+    double t1 = now_seconds();
+    for (int i = 0; i < count; i++)
+        exec_set_limits(&progs[i].ex, max_steps, deadline);
+    atomic_init(&b.running, scheduled);
+    for (unsigned i = 0; i < nworkers; i++)
+        if (pthread_create(&workers[i].thread, NULL, worker_thread, &workers[i]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    unsigned idle = 0;
+    while (finished < scheduled) {
+        int got = 0;
+        for (unsigned i = 0; i < nworkers; i++) {
+            Program *p;
+            while (queue_try_pop(&workers[i].done, &p)) {
+                finish_program(p);
+                latency[finished++] = p->finished - t1;
+                got = 1;
+            }
+        }
+        if (got) idle = 0;
+        else idle_wait(&idle);
+    }
+    unsigned long slices = 0, steals = 0;
+    for (unsigned i = 0; i < nworkers; i++) {
+        pthread_join(workers[i].thread, NULL);
+        slices += workers[i].slices;
+        steals += workers[i].steals;
+        free(workers[i].deque.items);
+        free(workers[i].done.items);
+    }
+    double t2 = now_seconds();
+
+    if (show_times && finished) {
+        qsort(latency, finished, sizeof(double), compare_double);
+        fprintf(stderr, "batch:   %zu programs, %u workers, slice %u statements\n",
+                finished, nworkers, (unsigned)slice);
+        fprintf(stderr, "parse:   %8.3f ms\n", (t1 - t0) * 1e3);
+        fprintf(stderr, "execute: %8.3f ms  (%lu slices, %lu stolen)\n", (t2 - t1) * 1e3, slices, steals);
+        fprintf(stderr, "latency: p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+                latency[finished / 2] * 1e3, latency[(finished * 99) / 100] * 1e3,
+                latency[finished - 1] * 1e3);
+    }
+    free(latency);
+    free(workers);
+    free(progs);
+    return failed;
+}
+
+/* ---- serving (-serve, -metrics) ----
+   -serve keeps the compiler running as a service: each line read from
+   stdin names program directories, which run as one -batch, and "ok N" or
+   "failed N" (N programs) is written to stdout when they are done. The AST
+   and the loaded modules are dropped between requests; compiled modules
+   stay in the -module-cache.
+   -metrics ADDR answers every request on ADDR with the metrics in the
+   Prometheus text format: ADDR is PORT or HOST:PORT for TCP (HOST
+   defaults to 127.0.0.1) or unix:PATH. The listener is a thread that lives
+   until the process exits; it serves one connection at a time. */
+#ifndef _WIN32
+static const char *const counter_names[M_COUNTERS][2] = {
+    { "compiler_programs_total", "Programs run to the end." },
+    { "compiler_statements_total", "Statements executed." },
+    { "compiler_errors_total", "Errors reported." },
+    { "compiler_module_cache_hits_total", "Imported modules loaded from the module cache." },
+    { "compiler_module_compiles_total", "Imported modules compiled." },
+};
+static const char *const gauge_names[M_GAUGES][2] = {
+    { "compiler_ast_nodes", "Nodes in the AST arena after the last parse." },
+    { "compiler_ast_arena_bytes", "Bytes of AST arena chunks allocated." },
+    { "compiler_hashcons_table_bytes", "Bytes of the hash-consing table." },
+    { "compiler_location_table_bytes", "Bytes of the statement and expression location tables." },
+};
+static const char *const hist_names[M_HISTS][2] = {
+    { "compiler_lex_seconds", "Lexing time of a program lexed ahead (-tokens, -fast-lex)." },
+    { "compiler_parse_seconds", "Parsing time of a program, including lexing unless lexed ahead." },
+    { "compiler_execute_seconds", "Execution time of a program, from its first statement to its last." },
+};
+
+/* the shards summed, as a Prometheus text exposition */
+static void metrics_write(OutBuf *b) {
+    static uint64_t bucket[M_HISTS][HIST_BUCKETS];     /* listener thread only */
+    uint64_t counter[M_COUNTERS] = { 0 }, sum_ns[M_HISTS] = { 0 };
+    memset(bucket, 0, sizeof bucket);
+    for (unsigned s = 0; s < METRIC_SHARDS; s++) {
+        MetricShard *m = &metric_shards[s];
+        for (int i = 0; i < M_COUNTERS; i++)
+            counter[i] += atomic_load_explicit(&m->counter[i], memory_order_relaxed);
+        for (int h = 0; h < M_HISTS; h++) {
+            sum_ns[h] += atomic_load_explicit(&m->sum_ns[h], memory_order_relaxed);
+            for (int i = 0; i < HIST_BUCKETS; i++)
+                bucket[h][i] += atomic_load_explicit(&m->bucket[h][i], memory_order_relaxed);
+        }
+    }
+    for (int i = 0; i < M_COUNTERS; i++)
+        out_printf(b, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", counter_names[i][0],
+                   counter_names[i][1], counter_names[i][0], counter_names[i][0],
+                   (unsigned long long)counter[i]);
+    for (int i = 0; i < M_GAUGES; i++)
+        out_printf(b, "# HELP %s %s\n# TYPE %s gauge\n%s %llu\n", gauge_names[i][0],
+                   gauge_names[i][1], gauge_names[i][0], gauge_names[i][0],
+                   (unsigned long long)atomic_load_explicit(&metric_gauge[i], memory_order_relaxed));
+    /* one exposed bucket per power of two: le = 2^k ns ends a whole octave
+       of the fine buckets */
+    for (int h = 0; h < M_HISTS; h++) {
+        const char *name = hist_names[h][0];
+        uint64_t count = bucket[h][0];
+        out_printf(b, "# HELP %s %s\n# TYPE %s histogram\n", name, hist_names[h][1], name);
+        for (int k = 0; k <= HIST_OCTAVES; k++) {
+            if (k > 0)
+                for (int i = 0; i < 1 << HIST_SUB_BITS; i++)
+                    count += bucket[h][1 + ((k - 1) << HIST_SUB_BITS) + i];
+            out_printf(b, "%s_bucket{le=\"%.9g\"} %llu\n", name,
+                       (double)(1ull << (HIST_MIN_SHIFT + k)) / 1e9, (unsigned long long)count);
+        }
+        count += bucket[h][HIST_BUCKETS - 1];
+        out_printf(b, "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %.9f\n%s_count %llu\n", name,
+                   (unsigned long long)count, name, sum_ns[h] / 1e9, name, (unsigned long long)count);
+    }
+}
+
+static void *metrics_thread(void *arg) {
+    int listener = (int)(intptr_t)arg;
+    OutBuf body = { 0 };
+    char request[4096], header[160];
+    for (;;) {
+        int c = accept(listener, NULL, NULL);
+        if (c < 0) continue;
+        /* the request itself is not looked at; read it so closing the
+           connection does not reset it */
+        if (recv(c, request, sizeof request, 0) >= 0) {
+            body.len = 0;
+            metrics_write(&body);
+            int n = snprintf(header, sizeof header,
+                             "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                             "Content-Length: %zu\r\n\r\n", body.len);
+            if (send(c, header, (size_t)n, MSG_NOSIGNAL) == n)
+                send(c, body.data, body.len, MSG_NOSIGNAL);
+        }
+        close(c);
+    }
+    return NULL;
+}
+
+/* start the listener; 0 with a message if ADDR cannot be listened on */
+int metrics_start(const char *addr) {
+    int fd;
+    if (strncmp(addr, "unix:", 5) == 0) {
+        struct sockaddr_un sun = { .sun_family = AF_UNIX };
+        if (strlen(addr + 5) >= sizeof sun.sun_path) { fprintf(stderr, "%s: path too long\n", addr); return 0; }
+        strcpy(sun.sun_path, addr + 5);
+        unlink(sun.sun_path);
+        if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+            bind(fd, (struct sockaddr*)&sun, sizeof sun) != 0) { perror(addr); return 0; }
+    } else {
+        struct sockaddr_in sin = { .sin_family = AF_INET };
+        const char *colon = strrchr(addr, ':');
+        char host[64] = "127.0.0.1";
+        if (colon) {
+            if ((size_t)(colon - addr) >= sizeof host) { fprintf(stderr, "%s: bad address\n", addr); return 0; }
+            memcpy(host, addr, (size_t)(colon - addr));
+            host[colon - addr] = '\0';
+        }
+        int port = atoi(colon ? colon + 1 : addr), one = 1;
+        if (port <= 0 || port > 65535 || inet_pton(AF_INET, host, &sin.sin_addr) != 1) {
+            fprintf(stderr, "%s: bad address\n", addr);
+            return 0;
+        }
+        sin.sin_port = htons((uint16_t)port);
+        if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) { perror(addr); return 0; }
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+        if (bind(fd, (struct sockaddr*)&sin, sizeof sin) != 0) { perror(addr); return 0; }
+    }
+    if (listen(fd, 16) != 0) { perror(addr); return 0; }
+    metric_shards = (MetricShard*)calloc(METRIC_SHARDS, sizeof(MetricShard));
+    if (!metric_shards) { perror("calloc"); exit(1); }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, metrics_thread, (void*)(intptr_t)fd) != 0) {
+        perror("pthread_create");
+        exit(1);
+    }
+    pthread_detach(thread);
+    return 1;
+}
+#else
+int metrics_start(const char *addr) {
+    fprintf(stderr, "%s: -metrics is not supported on Windows\n", addr);
+    return 0;
+}
+#endif
+
+/* -serve: 0 at the end of stdin */
+int run_serve(unsigned nworkers, uint32_t slice, uint64_t max_steps, double deadline,
+              size_t max_memory, int show_times, int optimize) {
+    char line[65536];
+    while (fgets(line, sizeof line, stdin)) {
+        char *dirs[1024];
+        int count = 0;
+        for (char *d = strtok(line, " \t\r\n"); d && count < 1024; d = strtok(NULL, " \t\r\n"))
+            dirs[count++] = d;
+        if (count == 0) continue;
+        int failed = run_batch(dirs, count, nworkers, slice, max_steps, deadline,
+                               max_memory, show_times, optimize, NULL);
+        ast_free();
+        modules_free();
+        shared_report(stdout);
+        printf("%s %d\n", failed ? "failed" : "ok", count);
+        fflush(stdout);
+    }
+    return 0;
+}
+
+/* ---- speculative execution ----
+   With -speculate N the top-level statements are cut into blocks of
+   -spec-block statements. N worker threads run the blocks ahead of the
+   main thread, each in a copy-on-write fork of the committed state taken
+   when the block was handed out, recording which variables it reads and
+   writes. The main thread commits the blocks in program order. A block is
+   valid if none of the variables it read was written by a block committed
+   after its fork. Then its writes are copied into the committed state and
+   its output and errors are emitted. Otherwise it is thrown away and run
+   again on the committed state. Output is therefore the same as a
+   sequential run. A block waiting to be committed that no worker has
+   started is run by the main thread itself. */
+enum { SPEC_FREE, SPEC_READY, SPEC_RUNNING, SPEC_DONE };
+
+typedef struct SpecSlot {
+    _Atomic int state;
+    size_t block;               /* index of the block */
+    size_t snapshot;            /* blocks committed when it was forked */
+    Exec ex;
+    ErrorList errors;
+} SpecSlot;
+
+typedef struct Speculation {
+    SpecSlot *slots;            /* block b uses slots[b % nslots] */
+    unsigned nslots;
+    NodeId *stmts;              /* the top-level statements in order */
+    size_t count, block_size;
+    _Atomic int finished;       /* tells the workers to exit */
+} Speculation;
+
+/* the statements of a stmt-list in program order */
+static NodeId *flatten_list(NodeId list, size_t *count) {
+    Exec tmp;
+    exec_init(&tmp, NULL, NULL, NULL);
+    exec_push_list(&tmp, list);
+    NodeId *stmts = (NodeId*)malloc((tmp.depth ? tmp.depth : 1) * sizeof(NodeId));
+    if (!stmts) { perror("malloc"); exit(1); }
+    *count = tmp.depth;
+    for (size_t i = 0; i < tmp.depth; i++)
+        stmts[i] = tmp.stack[tmp.depth - 1 - i];
+    exec_free(&tmp);
+    return stmts;
+}
+
+static void spec_push_block(Speculation *sp, Exec *ex, size_t block) {
+    size_t first = block * sp->block_size;
+    size_t end = first + sp->block_size < sp->count ? first + sp->block_size : sp->count;
+    for (size_t i = end; i > first; i--)
+        exec_push(ex, sp->stmts[i - 1]);
+}
+
+static void spec_run_slot(Speculation *sp, SpecSlot *slot) {
+    ErrorList *saved = pending_errors;
+    pending_errors = &slot->errors;
+    spec_push_block(sp, &slot->ex, slot->block);
+    exec_run(&slot->ex, 0);
+    pending_errors = saved;
+    atomic_store_explicit(&slot->state, SPEC_DONE, memory_order_release);
+}
+
+static void *spec_worker(void *arg) {
+    Speculation *sp = (Speculation*)arg;
+    unsigned idle = 0;
+    while (!atomic_load_explicit(&sp->finished, memory_order_acquire)) {
+        int ran = 0;
+        for (unsigned i = 0; i < sp->nslots; i++) {
+            int ready = SPEC_READY;
+            if (atomic_compare_exchange_strong_explicit(&sp->slots[i].state, &ready, SPEC_RUNNING,
+                    memory_order_acquire, memory_order_relaxed)) {
+                spec_run_slot(sp, &sp->slots[i]);
+                ran = 1;
+            }
+        }
+        if (ran) idle = 0;
+        else idle_wait(&idle);
+    }
+    return NULL;
+}
+
+/* run the program in `committed` (the main Exec, writing to the files);
+   returns the number of blocks that had to be run again */
+size_t run_speculative(Exec *committed, NodeId list, unsigned nworkers, size_t block_size,
+                       size_t *block_count) {
+    Speculation sp;
+    uint64_t version[MAX_VARS];     /* 1 + last block committed that wrote the variable */
+    size_t next_fill = 0, next_commit = 0, conflicts = 0;
+    pthread_t *threads = (pthread_t*)malloc((nworkers ? nworkers : 1) * sizeof(pthread_t));
+
+    memset(&sp, 0, sizeof sp);
+    memset(version, 0, sizeof version);
+    sp.stmts = flatten_list(list, &sp.count);
+    sp.block_size = block_size ? block_size : 1;
+    sp.nslots = 2 * nworkers + 1;
+    sp.slots = (SpecSlot*)calloc(sp.nslots, sizeof(SpecSlot));
+    if (!threads || !sp.slots) { perror("malloc"); exit(1); }
+    atomic_init(&sp.finished, 0);
+    size_t nblocks = (sp.count + sp.block_size - 1) / sp.block_size;
+    *block_count = nblocks;
+
+    for (unsigned i = 0; i < nworkers; i++)
+        if (pthread_create(&threads[i], NULL, spec_worker, &sp) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+
+    while (next_commit < nblocks && !committed->stopped) {
+        for (; next_fill < nblocks && next_fill < next_commit + sp.nslots; next_fill++) {
+            SpecSlot *slot = &sp.slots[next_fill % sp.nslots];
+            exec_fork(&slot->ex, committed, NULL, NULL, committed->mem);
+            slot->ex.track_vars = 1;
+            slot->block = next_fill;
+            slot->snapshot = next_commit;
+            atomic_store_explicit(&slot->state, SPEC_READY, memory_order_release);
+        }
+
+        SpecSlot *slot = &sp.slots[next_commit % sp.nslots];
+        int ready = SPEC_READY;
+        if (atomic_compare_exchange_strong_explicit(&slot->state, &ready, SPEC_RUNNING,
+                memory_order_acquire, memory_order_relaxed))
+            spec_run_slot(&sp, slot);
+        unsigned idle = 0;
+        while (atomic_load_explicit(&slot->state, memory_order_acquire) != SPEC_DONE)
+            idle_wait(&idle);
+
+        Exec *ex = &slot->ex;
+        int valid = !ex->stopped && !ex->alloc_failed && !ex->out.full && !ex->tree.full;
+        for (int id = 0; valid && id < MAX_VARS; id++)
+            if ((ex->reads[id >> 6] >> (id & 63) & 1) && version[id] > slot->snapshot)
+                valid = 0;
+
+        if (valid) {
+            for (int id = 0; id < MAX_VARS; id++)
+                if (ex->writes[id >> 6] >> (id & 63) & 1) {
+                    var_copy(committed, ex, id);
+                    version[id] = next_commit + 1;
+                }
+            out_write(&committed->out, ex->out.data, ex->out.len);
+            out_write(&committed->tree, ex->tree.data, ex->tree.len);
+            for (size_t i = 0; i < slot->errors.count; i++)
+                semantic_error_at(slot->errors.items[i].msg, slot->errors.items[i].stmt,
+                                  slot->errors.items[i].use);
+        } else {
+            conflicts++;
+            memset(committed->writes, 0, sizeof committed->writes);
+            committed->track_vars = 1;
+            spec_push_block(&sp, committed, next_commit);
+            exec_run(committed, 0);
+            committed->track_vars = 0;
+            for (int id = 0; id < MAX_VARS; id++)
+                if (committed->writes[id >> 6] >> (id & 63) & 1)
+                    version[id] = next_commit + 1;
+        }
+        exec_free(ex);
+        free(slot->errors.items);
+        memset(&slot->errors, 0, sizeof slot->errors);
+        atomic_store_explicit(&slot->state, SPEC_FREE, memory_order_relaxed);
+        next_commit++;
+    }
+
+    atomic_store_explicit(&sp.finished, 1, memory_order_release);
+    for (unsigned i = 0; i < nworkers; i++)
+        pthread_join(threads[i], NULL);
+    /* blocks handed out beyond a stop are dropped */
+    for (unsigned i = 0; i < sp.nslots; i++) {
+        exec_free(&sp.slots[i].ex);
+        free(sp.slots[i].errors.items);
+    }
+    free(sp.slots);
+    free(sp.stmts);
+    free(threads);
+    return conflicts;
+}
+
+/* ---- -bench-map ----
+   Lookup tables written with a map against the nested if/else chains that
+   programs use without one. For each table size the same random lookups
+   run as `print(m[k]);` and as a chain of `if (k == key):` tests that sets
+   r before `print(r);`; the chain runs once more after -O, which lowers it
+   to a switch. The lookups sit in a one-pass while so that -O cannot fold k
+   into the tests. Parsing is not timed, and no tree.txt text is produced:
+   rendering it costs more than the lookups being compared. */
+
+/* parse (and with optimize, -O) the program text in f and run it, keeping
+   the Print lines of its output in *prints; returns the execution time
+   (-1: it did not parse) */
+static double bench_run(FILE *f, int optimize, char **prints) {
+    rewind(f);
+    scanner_reset(f, 0);
+    program_root = 0;
+    if (yyparse() != 0) return -1;
+    if (optimize) optimize_program(program_root, NULL);
+    Exec ex;
+    exec_init(&ex, NULL, NULL, NULL);
+    ex.no_tree = 1;
+    exec_push_list(&ex, program_root);
+    double t0 = now_seconds();
+    exec_run(&ex, 0);
+    double t = now_seconds() - t0;
+    out_write(&ex.out, "", 1);
+    char *kept = (char*)malloc(ex.out.len), *k = kept;
+    if (!kept) { perror("malloc"); exit(1); }
+    for (char *line = ex.out.data; *line; ) {
+        char *end = strchr(line, '\n');
+        size_t len = end ? (size_t)(end - line) + 1 : strlen(line);
+        if (strncmp(line, "Print:", 6) == 0) { memcpy(k, line, len); k += len; }
+        line += len;
+    }
+    *k = '\0';
+    *prints = kept;
+    exec_free(&ex);
+    ast_free();
+    return t;
+}
+
+void map_benchmark(FILE *out) {
+    static const int sizes[] = { 4, 16, 64 };
+    yyError = stderr;
+    srand(1);
+    fprintf(out, "%6s %8s %14s %14s %14s %8s %8s\n", "keys", "lookups", "map /s", "if-chain /s",
+            "-O chain /s", "speedup", "vs -O");
+    for (size_t s = 0; s < sizeof sizes / sizeof sizes[0]; s++) {
+        int n = sizes[s], lookups = 4096 / n;
+        int *keys = (int*)malloc(n * sizeof(int)), *vals = (int*)malloc(n * sizeof(int));
+        FILE *with_map = tmpfile(), *with_ifs = tmpfile();
+        if (!keys || !vals) { perror("malloc"); exit(1); }
+        if (!with_map || !with_ifs) { perror("tmpfile"); exit(1); }
+        for (int i = 0; i < n; i++) {
+            keys[i] = i * 7919 + rand() % 7919;
+            vals[i] = rand() % 100000;
+        }
+        fprintf(with_map, "map m;\nint k = 0;\nint l = 0;\n");
+        for (int i = 0; i < n; i++) fprintf(with_map, "m[%d] = %d;\n", keys[i], vals[i]);
+        fprintf(with_map, "while (l < 1):\n");
+        fprintf(with_ifs, "int r = 0;\nint k = 0;\nint l = 0;\nwhile (l < 1):\n");
+        for (int l = 0; l < lookups; l++) {
+            int key = keys[rand() % n];
+            fprintf(with_map, "k = %d;\nprint(m[k]);\n", key);
+            fprintf(with_ifs, "k = %d;\n", key);
+            for (int i = 0; i < n; i++)
+                fprintf(with_ifs, "if (k == %d):\nr = %d;\n%s", keys[i], vals[i], i + 1 < n ? "else:\n" : "");
+            for (int i = 0; i < n; i++) fprintf(with_ifs, "end\n");
+            fprintf(with_ifs, "print(r);\n");
+        }
+        fprintf(with_map, "l = l + 1;\nend\n");
+        fprintf(with_ifs, "l = l + 1;\nend\n");
+        char *map_prints, *if_prints, *opt_prints;
+        double map_time = bench_run(with_map, 0, &map_prints);
+        double if_time = bench_run(with_ifs, 0, &if_prints);
+        double opt_time = bench_run(with_ifs, 1, &opt_prints);
+        fclose(with_map);
+        fclose(with_ifs);
+        if (map_time < 0 || if_time < 0 || opt_time < 0) { fprintf(out, "benchmark program did not parse\n"); return; }
+        fprintf(out, "%6d %8d %14.0f %14.0f %14.0f %7.1fx %7.1fx%s\n", n, lookups,
+                map_time > 0 ? lookups / map_time : 0.0, if_time > 0 ? lookups / if_time : 0.0,
+                opt_time > 0 ? lookups / opt_time : 0.0,
+                map_time > 0 ? if_time / map_time : 0.0, map_time > 0 ? opt_time / map_time : 0.0,
+                strcmp(map_prints, if_prints) || strcmp(map_prints, opt_prints) ? "  (outputs DIFFER)" : "");
+        free(map_prints);
+        free(if_prints);
+        free(opt_prints);
+        free(keys);
+        free(vals);
+    }
+}
+
+void usage(void) {
+    fprintf(stderr,
+        "usage: compiler [options]\n"
+        "  -tokens              lex all of in.txt into a token array before parsing\n"
+        "  -fast-lex            like -tokens, using the SIMD scanning fast path\n"
+        "  -bench-lex           compare Flex and fast-path lexing speed on in.txt\n"
+        "  -bench-map           compare map lookups with if/else chains\n"
+        "  -dump-tokens FILE    save the token array to FILE (implies -tokens)\n"
+        "  -replay-tokens FILE  parse a saved token array instead of in.txt\n"
+        "  -pipeline            lex, parse and execute on three threads\n"
+        "  -time                print lex/parse/execute times to stderr\n"
+        "  -O                   optimize the program before running it\n"
+        "  -unroll N            unroll loops N passes at a time (default 4; implies -O)\n"
+        "  -opt-report FILE     write what -O did to the program to FILE (implies -O)\n"
+        "  -module-cache DIR    keep compiled imported modules in DIR (default .modcache)\n"
+        "  -batch DIR...        run DIR/in.txt of every DIR concurrently\n"
+        "  -serve               run a -batch for each line of directories read from stdin\n"
+        "  -metrics ADDR        serve Prometheus metrics on [HOST:]PORT or unix:PATH\n"
+        "  -fork DIR...         run in.txt, then DIR/in.txt of every DIR as its continuation\n"
+        "  -speculate N         run blocks of statements ahead on N threads, with rollback\n"
+        "  -spec-block N        statements per speculative block (default 64)\n"
+        "  -coverage FILE       count the statements and branches run, into FILE\n"
+        "  -coverage-report FILE  print in.txt with the counts saved by -coverage\n"
+        "  -profile FILE        save the statement, branch and loop counts to FILE\n"
+        "  -profile-use FILE    optimize with the counts saved by -profile (implies -O)\n"
+        "  -dump-tree FMT FILE  write the tree of in.txt to FILE as json, dot or bin\n"
+        "  -debug               run under the debugger command protocol on stdin/stdout\n"
+        "  -diagnostics FMT     collect errors, once each with a count, and write them at\n"
+        "                       exit as text or jsonl\n"
+        "  -max-errors N        distinct errors -diagnostics keeps (default 100)\n"
+        "  -shared NAME[:MODE]  share variable NAME between all programs; MODE is\n"
+        "                       seq_cst (default), relaxed or sharded\n"
+        "  -workers N           worker threads for -batch (default: one per CPU)\n"
+        "  -slice N             statements a -batch program runs before yielding\n"
+        "  -max-steps N         stop a program after N statements\n"
+        "  -deadline MS         stop a program after MS milliseconds of execution\n"
+        "  -max-memory KB       stop a program that needs more than KB kilobytes\n"
+        "  -checkpoint FILE     save the program to FILE when a limit stops it\n"
+        "  -checkpoint-every N  also save it every N statements\n"
+        "  -restore FILE        resume a program saved with -checkpoint\n"
+        "  -record FILE         log the inputs, engine and limits of the run to FILE\n"
+        "  -replay FILE         run a program logged with -record again, exactly\n");
 }
 
 /* main: open files and run parser */
-int main(void) {
-    yyin = fopen("in.txt", "r");
-    yyout = fopen("out.txt", "w");
-    yytree = fopen("tree.txt", "w");
-    yyError = fopen("outError.txt", "w");
+int main(int argc, char **argv) {
+    int pre_lex = 0, fast_lex = 0, bench_lex = 0, show_times = 0, pipelined = 0;
+    const char *dump_tokens = NULL, *replay_tokens = NULL;
+    char **batch_dirs = NULL, **fork_dirs = NULL;
+    int batch_count = 0, fork_count = 0, failed = 0;
+    unsigned workers = 0;
+    uint32_t slice = 1000;
+    uint64_t max_steps = 0;
+    double deadline = 0;
+    size_t max_memory = 0;
+    const char *checkpoint = NULL, *restore = NULL;
+    uint64_t checkpoint_every = 0;
+    int speculate = -1, debug = 0, optimize = 0, serve = 0;
+    const char *metrics_addr = NULL;
+    const char *record_file = NULL, *replay_file = NULL;
+    const char *opt_report_file = NULL;
+    const char *coverage = NULL, *coverage_file = NULL;
+    const char *profile_file = NULL, *profile_use = NULL;
+    const char *dump_tree = NULL;
+    int dump_format = TREE_JSON;
+    size_t spec_block = 64;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-tokens") == 0) pre_lex = 1;
+        else if (strcmp(argv[i], "-fast-lex") == 0) pre_lex = fast_lex = 1;
+        else if (strcmp(argv[i], "-bench-lex") == 0) bench_lex = 1;
+        else if (strcmp(argv[i], "-bench-map") == 0) {
+            map_benchmark(stdout);
+            return 0;
+        }
+        else if (strcmp(argv[i], "-time") == 0) show_times = 1;
+        else if (strcmp(argv[i], "-O") == 0) optimize = 1;
+        else if (strcmp(argv[i], "-unroll") == 0 && i + 1 < argc) { unroll_factor = (uint32_t)atoi(argv[++i]); optimize = 1; }
+        else if (strcmp(argv[i], "-opt-report") == 0 && i + 1 < argc) { opt_report_file = argv[++i]; optimize = 1; }
+        else if (strcmp(argv[i], "-module-cache") == 0 && i + 1 < argc) module_cache_dir = argv[++i];
+        else if (strcmp(argv[i], "-pipeline") == 0) pipelined = 1;
+        else if (strcmp(argv[i], "-dump-tokens") == 0 && i + 1 < argc) { dump_tokens = argv[++i]; pre_lex = 1; }
+        else if (strcmp(argv[i], "-replay-tokens") == 0 && i + 1 < argc) replay_tokens = argv[++i];
+        else if (strcmp(argv[i], "-workers") == 0 && i + 1 < argc) workers = (unsigned)atoi(argv[++i]);
+        else if (strcmp(argv[i], "-slice") == 0 && i + 1 < argc) slice = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "-max-steps") == 0 && i + 1 < argc) max_steps = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-deadline") == 0 && i + 1 < argc) deadline = atof(argv[++i]) / 1e3;
+        else if (strcmp(argv[i], "-max-memory") == 0 && i + 1 < argc) max_memory = (size_t)strtoull(argv[++i], NULL, 10) * 1024;
+        else if (strcmp(argv[i], "-checkpoint") == 0 && i + 1 < argc) checkpoint = argv[++i];
+        else if (strcmp(argv[i], "-checkpoint-every") == 0 && i + 1 < argc) checkpoint_every = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-restore") == 0 && i + 1 < argc) restore = argv[++i];
+        else if (strcmp(argv[i], "-record") == 0 && i + 1 < argc) record_file = argv[++i];
+        else if (strcmp(argv[i], "-replay") == 0 && i + 1 < argc) replay_file = argv[++i];
+        else if (strcmp(argv[i], "-debug") == 0) debug = 1;
+        else if (strcmp(argv[i], "-serve") == 0) serve = 1;
+        else if (strcmp(argv[i], "-metrics") == 0 && i + 1 < argc) metrics_addr = argv[++i];
+        else if (strcmp(argv[i], "-diagnostics") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "text") == 0) diag_format = DIAG_TEXT;
+            else if (strcmp(argv[i], "jsonl") == 0) diag_format = DIAG_JSONL;
+            else { usage(); return 1; }
+        }
+        else if (strcmp(argv[i], "-max-errors") == 0 && i + 1 < argc) {
+            diag_max = (uint32_t)atoi(argv[++i]);
+            if (!diag_format) diag_format = DIAG_TEXT;
+        }
+        else if (strcmp(argv[i], "-coverage") == 0 && i + 1 < argc) coverage = argv[++i];
+        else if (strcmp(argv[i], "-coverage-report") == 0 && i + 1 < argc) coverage_file = argv[++i];
+        else if (strcmp(argv[i], "-profile") == 0 && i + 1 < argc) profile_file = argv[++i];
+        else if (strcmp(argv[i], "-profile-use") == 0 && i + 1 < argc) { profile_use = argv[++i]; optimize = 1; }
+        else if (strcmp(argv[i], "-dump-tree") == 0 && i + 2 < argc) {
+            if ((dump_format = tree_format(argv[++i])) < 0) { usage(); return 1; }
+            dump_tree = argv[++i];
+        }
+        else if (strcmp(argv[i], "-shared") == 0 && i + 1 < argc) {
+            if (!shared_define(argv[++i])) { usage(); return 1; }
+            record_shared(argv[i]);
+        }
+        else if (strcmp(argv[i], "-speculate") == 0 && i + 1 < argc) speculate = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-spec-block") == 0 && i + 1 < argc) spec_block = (size_t)strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-batch") == 0) { batch_dirs = argv + i + 1; batch_count = argc - i - 1; break; }
+        else if (strcmp(argv[i], "-fork") == 0) { fork_dirs = argv + i + 1; fork_count = argc - i - 1; break; }
+        else { usage(); return 1; }
+    }
+    /* a recording is of one program run from in.txt; the debugger's
+       commands are not recorded */
+    if ((record_file || replay_file) &&
+        ((record_file && (replay_file || debug)) || batch_dirs || fork_dirs || serve || checkpoint ||
+         restore || replay_tokens || dump_tokens || coverage_file || dump_tree)) { usage(); return 1; }
+    if (replay_file) {
+        /* the recorded options replace those given */
+        int engine;
+        if (!replay_load(replay_file, &engine, &optimize, &speculate, &spec_block,
+                         &max_steps, &max_memory)) return 1;
+        pre_lex = engine == ENGINE_TOKENS || engine == ENGINE_FAST_LEX;
+        fast_lex = engine == ENGINE_FAST_LEX;
+        pipelined = engine == ENGINE_PIPELINE;
+        deadline = 0;
+    }
+    if (record_file) record_mode = RECORD_ON;
+    if (pipelined && (pre_lex || replay_tokens || checkpoint || restore || fork_dirs)) { usage(); return 1; }
+    if (fork_dirs && fork_count == 0) { usage(); return 1; }
+    /* speculative blocks cannot be preempted or forked part-way */
+    if (speculate >= 0 && (pipelined || batch_dirs || fork_dirs || checkpoint || restore ||
+                           max_steps || deadline > 0 || shared_count)) { usage(); return 1; }
+    /* the debugger works on the statements of a single sequential run */
+    if (debug && (pipelined || batch_dirs || fork_dirs || checkpoint || restore || speculate >= 0)) {
+        usage();
+        return 1;
+    }
+    if (checkpoint_every && !checkpoint) { usage(); return 1; }
+    /* the counters are indexed by the NodeIds of one program run by one thread */
+    if ((coverage || profile_file || profile_use) &&
+        (pipelined || batch_dirs || fork_dirs || serve || speculate >= 0)) { usage(); return 1; }
+    /* the optimized program no longer has the statements these work on;
+       with -pipeline statements run before the rest is parsed */
+    if (optimize && (pipelined || debug || coverage || coverage_file || profile_file)) { usage(); return 1; }
+    /* a replay would be optimized without the profile */
+    if (profile_use && record_file) { usage(); return 1; }
+    /* the notes name the lines of in.txt */
+    if (opt_report_file && (batch_dirs || serve)) { usage(); return 1; }
+    /* a service runs batches only */
+    if (serve && (pipelined || pre_lex || replay_tokens || bench_lex || checkpoint || restore ||
+                  batch_dirs || fork_dirs || speculate >= 0 || debug || coverage ||
+                  coverage_file || dump_tree)) { usage(); return 1; }
+    if (metrics_addr && !metrics_start(metrics_addr)) return 1;
+    if (coverage_file) {
+        /* only parse: the outputs of the recorded run are left alone */
+        yyin = fopen("in.txt", "r");
+        if (!yyin) { perror("open in.txt"); return 1; }
+        yyError = stderr;
+        if (modules_prepare(yyin, ".")) scanner_reset(yyin, 0);
+        if (yyparse() != 0 || !coverage_report(coverage_file, yyin, stdout)) failed = 1;
+        if (diag_format) diag_flush(stderr);
+        ast_free();
+        modules_free();
+        fclose(yyin);
+        return failed;
+    }
+    if (dump_tree) {
+        /* only parse, as for -coverage-report */
+        FILE *f;
+        yyin = fopen("in.txt", "r");
+        if (!yyin) { perror("open in.txt"); return 1; }
+        if (!(f = fopen(dump_tree, dump_format == TREE_BIN ? "wb" : "w"))) { perror(dump_tree); return 1; }
+        yyError = stderr;
+        if (modules_prepare(yyin, ".")) scanner_reset(yyin, 0);
+        if (yyparse() != 0) failed = 1;
+        else tree_dump(f, program_root, dump_format);
+        if (diag_format) diag_flush(stderr);
+        if (fclose(f) != 0) { perror(dump_tree); failed = 1; }
+        if (failed) remove(dump_tree);
+        ast_free();
+        modules_free();
+        fclose(yyin);
+        return failed;
+    }
+    if (workers == 0) workers = cpu_count();
+    if (workers == 0) workers = 1;
+    if (serve) return run_serve(workers, slice, max_steps, deadline, max_memory, show_times, optimize);
+    if (batch_dirs) {
+        if (batch_count == 0 || pipelined || pre_lex || replay_tokens || bench_lex ||
+            checkpoint || restore) { usage(); return 1; }
+        failed = run_batch(batch_dirs, batch_count, workers, slice, max_steps, deadline,
+                               max_memory, show_times, optimize, NULL);
+        shared_report(stdout);
+        ast_free();
+        modules_free();
+        return failed;
+    }
 
-    if (!yyin) { perror("open in.txt"); return 1; }
+    if (replay_file) yyin = replay_program();
+    else if (!replay_tokens) yyin = fopen("in.txt", "r");
+    /* a restored program continues the outputs of the run it was saved from */
+    yyout = fopen("out.txt", restore ? "r+" : "w");
+    yytree = fopen("tree.txt", restore ? "r+" : "w");
+    yyError = fopen("outError.txt", restore ? "r+" : "w");
+
+    if (!yyin && !replay_tokens) { perror("open in.txt"); return 1; }
+    if (bench_lex) {
+        tokens_benchmark(stdout);
+        return 0;
+    }
     if (!yyout) { perror("open out.txt"); return 1; }
     if (!yytree) { perror("open tree.txt"); return 1; }
 
+    /* the modules in.txt imports are compiled, or loaded from the cache */
+    double tm0 = now_seconds();
+    int imports = yyin ? modules_prepare(yyin, ".") : 0;
+    double tm1 = now_seconds();
+    if (imports) {
+        /* variable ids are handed out as the lexer meets an import: the
+           -pipeline lexer thread would race the parser for them, and a
+           token file would carry ids without the modules they come from */
+        if (pipelined || dump_tokens) {
+            fprintf(stderr, "in.txt: imports cannot be used with %s\n", pipelined ? "-pipeline" : "-dump-tokens");
+            return 1;
+        }
+        scanner_reset(yyin, 0);
+    }
+    if (record_file) {
+        int engine = pipelined ? ENGINE_PIPELINE : speculate >= 0 ? ENGINE_SPECULATE :
+                     fast_lex ? ENGINE_FAST_LEX : pre_lex ? ENGINE_TOKENS : ENGINE_SEQUENTIAL;
+        record_program(yyin);
+        if (!record_start(record_file, engine, optimize, speculate >= 0 ? (unsigned)speculate : 0,
+                          spec_block, max_steps, deadline, max_memory)) return 1;
+    }
+
+    static MemLimit mem;
+    mem.limit = max_memory;
+    mem_current = &mem;
+    Exec ex;
+    exec_init(&ex, yyout, yytree, &mem);
+
+    if (pipelined) {
+        exec_set_limits(&ex, max_steps, deadline);
+        replay_limits(&ex);
+        run_pipeline(&ex, show_times);
+        record_finish(&ex);
+        metric_add(M_PROGRAMS, 1);
+        metric_add(M_STATEMENTS, ex.issued - ex.fuel);
+        out_flush(&ex.out);
+        out_flush(&ex.tree);
+        exec_free(&ex);
+        ast_free();
+        record_free();
+        if (yyin) fclose(yyin);
+        fclose(yyout);
+        fclose(yytree);
+        if (diag_format) diag_flush(yyError);
+        if (yyError && yyError != stderr) fclose(yyError);
+        return 0;
+    }
+
+    /* when lexing ahead, hold lexer errors back until the parser has run
+       so they come out in the same order as in a normal run. When
+       restoring they are already in outError.txt and are dropped. */
+    ErrorList lex_errors = { 0 }, parse_errors = { 0 };
+    if (restore) pending_errors = &parse_errors;
+    double t0 = now_seconds();
+    if (replay_tokens) {
+        if (!tokens_load(replay_tokens)) return 1;
+    } else if (pre_lex) {
+        pending_errors = &lex_errors;
+        if (fast_lex) tokens_lex_fast();
+        else tokens_lex_all();
+        pending_errors = &parse_errors;
+        if (dump_tokens && !tokens_save(dump_tokens)) return 1;
+    }
+    double t1 = now_seconds();
+    int parse_status = yyparse();
+    double t2 = now_seconds();
+    pending_errors = NULL;
+    metric_arena();
+    /* before restoring too: a checkpoint records the optimized program */
+    if (optimize && parse_status == 0) {
+        FILE *report = NULL;
+        if (profile_use && !profile_load(profile_use)) return 1;
+        if (opt_report_file && !(report = fopen(opt_report_file, "w"))) { perror(opt_report_file); return 1; }
+        optimize_program(program_root, report);
+        if (report) fclose(report);
+    }
+    if (restore) {
+        lex_errors.count = parse_errors.count = 0;
+        if (!exec_restore(&ex, restore)) return 1;
+    } else if (parse_status == 0) {
+        exec_push_list(&ex, program_root);
+    }
+    flush_front_end_errors(&lex_errors, &parse_errors);
+    exec_set_limits(&ex, max_steps, deadline);
+    replay_limits(&ex);
+    exec_set_checkpoint(&ex, checkpoint, checkpoint_every);
+    size_t spec_blocks = 0, spec_conflicts = 0;
+    if (coverage || profile_file) {
+        ex.cov = (uint32_t*)calloc(ast_count, sizeof(uint32_t));
+        if (!ex.cov) { perror("calloc"); return 1; }
+    }
+    if (debug && parse_status == 0) debugger_start(&ex);
+    if (speculate >= 0 && ex.depth) {
+        ex.depth = 0;
+        spec_conflicts = run_speculative(&ex, program_root, (unsigned)speculate, spec_block, &spec_blocks);
+    }
+    exec_run(&ex, 0);
+    if (debug && parse_status == 0) printf("program finished\n");
+    if (coverage && !coverage_save(ex.cov, coverage)) failed = 1;
+    if (profile_file && !profile_save(ex.cov, profile_file)) failed = 1;
+    out_flush(&ex.out);
+    out_flush(&ex.tree);
+    double t3 = now_seconds();
+    record_finish(&ex);
+    if (pre_lex && !replay_tokens) metric_time(H_LEX, t1 - t0);
+    metric_time(H_PARSE, t2 - t1);
+    metric_time(H_EXECUTE, t3 - t2);
+    metric_add(M_PROGRAMS, 1);
+    metric_add(M_STATEMENTS, ex.issued - ex.fuel);
 
-    // initialize symbol table
-    for(int i = 0; i < 256; i++) {
-        sym[i] = 0;
-        declared[i] = 0;
+    if (fork_dirs && parse_status == 0 && !ex.stopped) {
+        /* the continuations get the prefix's variable ids */
+        scanner_save_vars();
+        fclose(yyin);
+        yyin = NULL;
+        failed = run_batch(fork_dirs, fork_count, workers, slice, max_steps, deadline,
+                           max_memory, show_times, optimize, &ex);
+        shared_report(stdout);
     }
 
-    yyparse();
+    if (show_times) {
+        if (imports)
+            fprintf(stderr, "modules: %8.3f ms  (%u compiled, %u from the cache)\n",
+                    (tm1 - tm0) * 1e3, modules_compiled, modules_cached);
+        if (replay_tokens)
+            fprintf(stderr, "load:    %8.3f ms  (%u tokens)\n", (t1 - t0) * 1e3, tok_count);
+        else if (pre_lex)
+            fprintf(stderr, "lex:     %8.3f ms  (%u tokens, %u bytes)\n", (t1 - t0) * 1e3, tok_count, src_offset);
+        fprintf(stderr, "parse:   %8.3f ms%s\n", (t2 - t1) * 1e3, (pre_lex || replay_tokens) ? "" : "  (including lexing)");
+        fprintf(stderr, "execute: %8.3f ms\n", (t3 - t2) * 1e3);
+        if (record_file)
+            fprintf(stderr, "record:  %8.3f ms  (%ld bytes)\n", record_seconds * 1e3, record_bytes);
+        if (speculate >= 0)
+            fprintf(stderr, "speculation: %zu blocks, %zu run again after a conflict\n",
+                    spec_blocks, spec_conflicts);
+    }
+    exec_free(&ex);
+    free(ex.cov);
+    ast_free();
+    modules_free();
+    record_free();
 
-    fclose(yyin);
+    if (yyin) fclose(yyin);
     fclose(yyout);
     fclose(yytree);
+    if (diag_format) diag_flush(yyError);
     if (yyError && yyError != stderr) fclose(yyError);
-    return 0;
+    return failed;
 }
@@ -1,4 +1,4 @@
 bison -d parser.y
 flex scanner.l
-gcc lex.yy.c parser.tab.c -o compiler
+gcc lex.yy.c parser.tab.c -o compiler -lpthread
 .\compiler.exe
\ No newline at end of file